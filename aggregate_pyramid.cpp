@@ -0,0 +1,167 @@
+#include <algorithm>
+#include "aggregate_pyramid.h"
+
+
+/// First stored level, for buckets of 2^4 = 16 positions. Finer buckets
+/// would take more memory than the column and save little, as the
+/// positions of a range outside coarser buckets are read directly.
+const int AggregatePyramid::kMinLevel_ = 4;
+
+/// Last stored level, for buckets of 2^12 = 4096 positions.
+const int AggregatePyramid::kNumLevels_ = 12;
+
+/**
+ * Builds the pyramid from a column of values.
+ *
+ * @param values Pointer to the first value of the column.
+ * @param valid Whether each value has data.
+ * @param size Number of values in the column.
+ */
+void AggregatePyramid::Build(const float * values, const Bitmap & valid,
+        const size_t size) {
+
+    levels_.assign(kNumLevels_ - kMinLevel_ + 1, std::vector<Bucket>());
+
+    for (int k = kMinLevel_; k <= kNumLevels_; k++) {
+
+        const size_t len = size_t(1) << k;
+        auto & level = levels_[k - kMinLevel_];
+        level.resize((size + len - 1) / len);
+
+        // buckets of the first level combine their positions, and the
+        // others combine two buckets of the level below
+        for (size_t j = 0; j < level.size(); j++) {
+            if (k == kMinLevel_) {
+                for (size_t i = j * len; i < std::min((j + 1) * len, size);
+                        i++)
+                    Combine(level[j], MakeBucket(values, valid, i));
+                continue;
+            }
+            const auto & below = levels_[k - kMinLevel_ - 1];
+            for (size_t half = 2 * j; half < 2 * j + 2; half++) {
+                if (half < below.size())
+                    Combine(level[j], below[half]);
+            }
+        }
+    }
+}
+
+/**
+ * Extends the pyramid with the last value of the column, which has just
+ * been appended, updating the last bucket of every level.
+ *
+ * @param values Pointer to the first value of the column.
+ * @param valid Whether each value has data.
+ * @param size Number of values in the column, including the new one.
+ */
+void AggregatePyramid::Append(const float * values, const Bitmap & valid,
+        const size_t size) {
+
+    if (levels_.empty())
+        levels_.assign(kNumLevels_ - kMinLevel_ + 1, std::vector<Bucket>());
+
+    const size_t i = size - 1;
+    const Bucket bucket = MakeBucket(values, valid, i);
+
+    for (int k = kMinLevel_; k <= kNumLevels_; k++) {
+        auto & level = levels_[k - kMinLevel_];
+        if ((i >> k) == level.size())
+            level.emplace_back();
+        Combine(level[i >> k], bucket);
+    }
+}
+
+/**
+ * Gets aggregates of the range [a, b), combining the coarsest aligned
+ * buckets that fit in it from left to right, and reading the positions
+ * that do not fill a stored bucket from the column.
+ *
+ * @param values Pointer to the first value of the column the pyramid was
+ * built from.
+ * @param valid Whether each value has data.
+ * @param a,b First and one past last positions of the range.
+ * @return Aggregates of the range.
+ */
+AggregatePyramid::Bucket AggregatePyramid::Query(const float * values,
+        const Bitmap & valid, size_t a, const size_t b) const {
+
+    Bucket bucket;
+
+    while (a < b) {
+
+        int k = 0;
+        while (k < kNumLevels_ && a % (size_t(2) << k) == 0
+                && a + (size_t(2) << k) <= b)
+            k++;
+
+        if (k < kMinLevel_) {
+            Combine(bucket, MakeBucket(values, valid, a));
+            a++;
+        } else {
+            Combine(bucket, levels_[k - kMinLevel_][a >> k]);
+            a += size_t(1) << k;
+        }
+    }
+
+    return bucket;
+}
+
+/**
+ * Gets bytes of memory used by the buckets of every level.
+ *
+ * @return Bytes of memory.
+ */
+size_t AggregatePyramid::MemoryBytes() const {
+
+    size_t bytes = 0;
+    for (const auto & level : levels_)
+        bytes += level.size() * sizeof(Bucket);
+
+    return bytes;
+}
+
+/**
+ * Combines the aggregates of a bucket with those of the bucket that
+ * follows it.
+ *
+ * @param bucket Bucket to update.
+ * @param next Bucket that follows it.
+ */
+void AggregatePyramid::Combine(Bucket & bucket, const Bucket & next) {
+
+    if (next.count == 0)
+        return;
+
+    if (bucket.count == 0) {
+        bucket = next;
+        return;
+    }
+
+    bucket.high = std::max(bucket.high, next.high);
+    bucket.low = std::min(bucket.low, next.low);
+    bucket.close = next.close;
+    bucket.sum += next.sum;
+    bucket.count += next.count;
+}
+
+/**
+ * Makes the bucket of a single position of the column.
+ *
+ * @param values Pointer to the first value of the column.
+ * @param valid Whether each value has data.
+ * @param i Position.
+ * @return Bucket of the position.
+ */
+AggregatePyramid::Bucket AggregatePyramid::MakeBucket(const float * values,
+        const Bitmap & valid, const size_t i) {
+
+    Bucket bucket;
+
+    if (valid.Test(i)) {
+        bucket.open = bucket.high = bucket.low = bucket.close = values[i];
+        bucket.sum = values[i];
+        bucket.count = 1;
+    }
+
+    return bucket;
+}
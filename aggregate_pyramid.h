@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "bitmap.h"
+
+
+/**
+ * Multi-resolution pyramid of aggregates over a column of values.
+ *
+ * Level k holds open, high, low, close, sum and count aggregates of
+ * buckets of 2^k consecutive positions, from 16 up to 4096 positions. Any
+ * range is answered by combining the coarsest aligned buckets that fit in
+ * it, and the positions at its ends that do not fill a bucket, so long
+ * ranges only touch a few entries. Levels below 16 positions are not
+ * stored, so the pyramid takes about 1/8 of a bucket, 4 bytes, per
+ * position.
+ */
+class AggregatePyramid {
+public:
+    /// Aggregates of a bucket of positions data structure, where every
+    /// value is -1 if there is no valid value in the bucket.
+    struct Bucket {
+        float open = -1.0f; ///< First valid value.
+        float high = -1.0f; ///< Maximum valid value.
+        float low = -1.0f; ///< Minimum valid value.
+        float close = -1.0f; ///< Last valid value.
+        double sum = 0.0; ///< Sum of valid values.
+        uint32_t count = 0; ///< Number of valid values.
+    };
+
+    // public functions
+    void Build(const float * values, const Bitmap & valid,
+            const size_t size);
+    void Append(const float * values, const Bitmap & valid,
+            const size_t size);
+    Bucket Query(const float * values, const Bitmap & valid,
+            size_t a, const size_t b) const;
+    size_t MemoryBytes() const;
+
+    static void Combine(Bucket & bucket, const Bucket & next);
+
+private:
+    static const int kMinLevel_;
+    static const int kNumLevels_;
+
+    /// Buckets of levels kMinLevel_ to kNumLevels_, where bucket j of level
+    /// k aggregates positions [j * 2^k, (j + 1) * 2^k).
+    std::vector<std::vector<Bucket>> levels_;
+
+    // helper functions
+    static Bucket MakeBucket(const float * values, const Bitmap & valid,
+            const size_t i);
+};
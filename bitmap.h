@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+/**
+ * Packed bitmap class, with one bit per position stored in 64-bit words.
+ */
+class Bitmap {
+public:
+    // public functions
+    void Assign(const size_t size, const bool value);
+    void AssignWords(const uint64_t * words, const size_t size);
+    void PushBack(const bool value);
+    void Append(const Bitmap & other);
+    void Set(const size_t i, const bool value);
+    bool Test(const size_t i) const;
+    size_t Size() const;
+    const uint64_t * Words() const;
+    size_t NumWords() const;
+
+    static size_t NumWordsFor(const size_t size);
+
+private:
+    std::vector<uint64_t> words_; ///< Packed bits, 64 per word.
+    size_t size_ = 0; ///< Number of bits.
+};
+
+/**
+ * Sets all bits to the same value.
+ *
+ * @param size New number of bits.
+ * @param value Value of every bit.
+ */
+inline void Bitmap::Assign(const size_t size, const bool value) {
+
+    size_ = size;
+    words_.assign(NumWordsFor(size), value ? ~uint64_t(0) : 0);
+
+    // keeps bits past the end cleared
+    if (value && size % 64 != 0)
+        words_.back() = (uint64_t(1) << (size % 64)) - 1;
+}
+
+/**
+ * Sets all bits from packed words.
+ *
+ * @param words Pointer to the first of NumWordsFor(size) words.
+ * @param size New number of bits.
+ */
+inline void Bitmap::AssignWords(const uint64_t * words, const size_t size) {
+
+    size_ = size;
+    words_.assign(words, words + NumWordsFor(size));
+
+    // clears bits past the end, which the words may have set
+    if (size % 64 != 0)
+        words_.back() &= (uint64_t(1) << (size % 64)) - 1;
+}
+
+/**
+ * Appends a bit.
+ *
+ * @param value Value of the new bit.
+ */
+inline void Bitmap::PushBack(const bool value) {
+
+    if (size_ % 64 == 0)
+        words_.push_back(0);
+    size_++;
+    Set(size_ - 1, value);
+}
+
+/**
+ * Appends the bits of another bitmap, shifting its words into place.
+ *
+ * @param other Bitmap whose bits are appended.
+ */
+inline void Bitmap::Append(const Bitmap & other) {
+
+    const size_t shift = size_ % 64;
+
+    if (shift == 0) {
+        words_.insert(words_.end(), other.words_.begin(), other.words_.end());
+    } else {
+        for (const uint64_t word : other.words_) {
+            words_.back() |= word << shift;
+            words_.push_back(word >> (64 - shift));
+        }
+    }
+
+    size_ += other.size_;
+    words_.resize(NumWordsFor(size_));
+}
+
+/**
+ * Sets a bit.
+ *
+ * @param i Position of the bit.
+ * @param value Value of the bit.
+ */
+inline void Bitmap::Set(const size_t i, const bool value) {
+
+    const uint64_t mask = uint64_t(1) << (i % 64);
+    words_[i / 64] = value ? (words_[i / 64] | mask) : (words_[i / 64] & ~mask);
+}
+
+/**
+ * Gets a bit.
+ *
+ * @param i Position of the bit.
+ * @return Value of the bit.
+ */
+inline bool Bitmap::Test(const size_t i) const {
+
+    return (words_[i / 64] >> (i % 64)) & 1;
+}
+
+/**
+ * Gets number of bits.
+ *
+ * @return Number of bits.
+ */
+inline size_t Bitmap::Size() const {
+
+    return size_;
+}
+
+/**
+ * Gets packed words, where bit i is bit (i % 64) of word (i / 64).
+ *
+ * @return Pointer to the first of NumWords() words.
+ */
+inline const uint64_t * Bitmap::Words() const {
+
+    return words_.data();
+}
+
+/**
+ * Gets number of packed words.
+ *
+ * @return Number of words.
+ */
+inline size_t Bitmap::NumWords() const {
+
+    return words_.size();
+}
+
+/**
+ * Gets number of packed words needed for a number of bits.
+ *
+ * @param size Number of bits.
+ * @return Number of words.
+ */
+inline size_t Bitmap::NumWordsFor(const size_t size) {
+
+    return (size + 63) / 64;
+}
@@ -1,18 +1,38 @@
 #include <iostream>
 #include "btc_chart.h"
+#include "scale.h"
+
+/// Color of Bitcoin price lines.
+const utils::RGBA BtcChart::kPriceColor_ = {0, 0, 0, 255};
 
 /**
  * Bitcoin chart config data structure constructor.
  */
 BtcChart::Cfg::Cfg(const int width, const int height,
-        const int day_a, const int day_b,
+        const int64_t time_a, const int64_t time_b,
         const float bottom_price, const float top_price,
-        const utils::Scale scale)
-    : width(width), height(height), day_a(day_a), day_b(day_b),
-        bottom_price(bottom_price), top_price(top_price), scale(scale) {}
+        const utils::Scale scale, const PriceMode price_mode,
+        const int num_threads)
+    : width(width), height(height), time_a(time_a), time_b(time_b),
+        bottom_price(bottom_price), top_price(top_price), scale(scale),
+        price_mode(price_mode), num_threads(num_threads) {}
+
+/**
+ * Constructor.
+ *
+ * @param btc_data Bitcoin data snapshot to draw, which can be shared by
+ * many charts.
+ * @param dataset Dataset of other series to draw, which can be shared by
+ * many charts, or null.
+ */
+BtcChart::BtcChart(std::shared_ptr<const BtcData> btc_data,
+        std::shared_ptr<const Dataset> dataset)
+    : btc_data_(std::move(btc_data)), dataset_(std::move(dataset)) {}
 
 /**
- * Generates a Bitcoin chart image.
+ * Generates a Bitcoin chart image. Its shapes are recorded first and then
+ * drawn and encoded on cfg.num_threads threads, with the image split in
+ * vertical strips.
  *
  * @param path Path where to save chart image.
  * @param cfg Bitcoin chart config data structure.
@@ -22,60 +42,198 @@ void BtcChart::Generate(const std::string & path, Cfg & cfg) {
     cfg_ = &cfg;
 
     Img img(cfg_->width, cfg_->height);
-    DrawPrice(img);
+
+    // the drawing code is specialized for each scale
+    switch (cfg_->scale) {
+        case utils::kLinear:
+            Draw<LinearScale>(img);
+            break;
+        case utils::kLogarithmic:
+            Draw<LogScale>(img);
+            break;
+    }
+
+    img.Flush(cfg_->num_threads);
+
+    PngWriter::Options png_options;
+    png_options.num_threads = cfg_->num_threads;
+    img.SetPngOptions(png_options);
 
     img.Write(path);
 }
 
 /**
- * Draws Bitcoin price on chart image.
+ * Draws Bitcoin price on chart image according to the price mode.
+ *
+ * @tparam ScalePolicy Scale of y value in chart, as a scale policy.
+ * @param img Image object.
+ */
+template <typename ScalePolicy>
+void BtcChart::Draw(Img & img) {
+
+    switch (cfg_->price_mode) {
+        case kAvgPrice:
+            DrawPrice<ScalePolicy>(img);
+            break;
+        case kEnvelopePrice:
+            DrawPriceEnvelope<ScalePolicy>(img);
+            break;
+    }
+}
+
+/**
+ * Draws Bitcoin price on chart image, as one polyline per run of columns
+ * with price data.
  *
+ * @tparam ScalePolicy Scale of y value in chart, as a scale policy.
  * @param img Image object.
  */
+template <typename ScalePolicy>
 void BtcChart::DrawPrice(Img & img) {
 
-    float prev_y = -1.0f;
+    const auto columns = ResampleColumns();
+
+    std::vector<float> ys(columns.size());
+    for (size_t x = 0; x < columns.size(); x++)
+        ys[x] = columns[x].avg;
+    PricesToY<ScalePolicy>(ys);
+
+    std::vector<Img::Point> run;
 
     for (int x = 0; x < cfg_->width; x++) {
 
-        const int start_day = XToDay(x - 1);
-        const int end_day = XToDay(x);
+        if (columns[x].avg == -1.0f) {
+            AddPriceRun(img, run);
+            continue;
+        }
+
+        run.push_back({float(x), ys[x]});
+    }
+
+    AddPriceRun(img, run);
+}
+
+/**
+ * Draws Bitcoin price on chart image as an M4 envelope: each column is
+ * joined to the previous one from its first price and drawn as a vertical
+ * line from its minimum to its maximum price, so no price spike is lost
+ * when many rows fall in the same column.
+ *
+ * @tparam ScalePolicy Scale of y value in chart, as a scale policy.
+ * @param img Image object.
+ */
+template <typename ScalePolicy>
+void BtcChart::DrawPriceEnvelope(Img & img) {
+
+    const auto columns = ResampleColumns();
+
+    // first, max, min and last prices of each column
+    std::vector<float> ys(4 * columns.size());
+    for (size_t x = 0; x < columns.size(); x++) {
+        ys[4 * x] = columns[x].first;
+        ys[4 * x + 1] = columns[x].max;
+        ys[4 * x + 2] = columns[x].min;
+        ys[4 * x + 3] = columns[x].last;
+    }
+    PricesToY<ScalePolicy>(ys);
+
+    std::vector<Img::Point> run;
+
+    for (int x = 0; x < cfg_->width; x++) {
 
-        const float price = btc_data_.GetAvgPrice(start_day, end_day);
-        const float y = (price == -1.0f) ? price : PriceToY(price);
+        const auto & column = columns[x];
 
-        if (prev_y != -1.0f && y != -1.0f)
-            img.DrawLine(float(x - 1), prev_y, float(x), y, "#000000");
+        if (column.avg == -1.0f) {
+            AddPriceRun(img, run);
+            continue;
+        }
 
-        prev_y = y;
+        for (int k = 0; k < 4; k++) {
+            const Img::Point point = {float(x), ys[4 * x + k]};
+            if (run.empty() || run.back().x != point.x
+                    || run.back().y != point.y)
+                run.push_back(point);
+        }
     }
+
+    AddPriceRun(img, run);
+}
+
+/**
+ * Records a run of price points in the image draw list as a polyline and
+ * clears it.
+ *
+ * @param img Image object.
+ * @param run Price points.
+ */
+void BtcChart::AddPriceRun(Img & img, std::vector<Img::Point> & run) {
+
+    if (run.size() > 1)
+        img.AddPolyline(std::move(run), kPriceColor_);
+
+    run.clear();
 }
 
 /**
- * Gets day according to x position in chart image.
+ * Aggregates the prices of the chart into its columns, either the price
+ * averaged across exchanges, a statistic of the prices of the chosen
+ * exchanges or the values of a dataset column. Unknown exchanges are
+ * reported and skipped, and unknown dataset columns are reported and
+ * drawn without data.
  *
- * @param x X position.
- * @return Day according to x position.
+ * @return Aggregated prices of each column.
  */
-int BtcChart::XToDay(const int x) {
+std::vector<BtcData::ColumnPrices> BtcChart::ResampleColumns() {
+
+    if (!cfg_->series.empty()) {
+        if (!dataset_ || !dataset_->HasColumn(cfg_->series))
+            std::cerr << "Error: unknown series " << cfg_->series << '\n';
+        else
+            return dataset_->Resample(cfg_->series, cfg_->time_a,
+                    cfg_->time_b, cfg_->width);
+        return std::vector<BtcData::ColumnPrices>(cfg_->width);
+    }
+
+    if (cfg_->exchanges.empty())
+        return btc_data_->Resample(cfg_->time_a, cfg_->time_b, cfg_->width);
 
-    return (cfg_->day_a + x * (cfg_->day_b - cfg_->day_a) / cfg_->width);
+    std::vector<int> exchange_ids;
+
+    for (const std::string & exchange : cfg_->exchanges) {
+
+        if (exchange == "all") {
+            for (size_t k = 0; k < btc_data_->GetExchanges().size(); k++)
+                exchange_ids.push_back(int(k));
+            continue;
+        }
+
+        const int id = btc_data_->GetExchangeId(exchange);
+        if (id < 0)
+            std::cerr << "Error: unknown exchange " << exchange << '\n';
+        else
+            exchange_ids.push_back(id);
+    }
+
+    return btc_data_->ResampleExchanges(cfg_->time_a, cfg_->time_b,
+            cfg_->width, exchange_ids, cfg_->exchange_stat);
 }
 
 /**
- * Gets y position in chart image according to price.
+ * Converts prices to y positions in chart image, in place. The bottom and
+ * top prices are scaled once, and the prices are scaled in one batch.
  *
- * @param price Price to convert.
- * @return Y position.
+ * @tparam ScalePolicy Scale of y value in chart, as a scale policy.
+ * @param prices Prices to convert to y positions.
  */
-float BtcChart::PriceToY(const float price) {
+template <typename ScalePolicy>
+void BtcChart::PricesToY(std::vector<float> & prices) {
+
+    const float height = float(cfg_->height);
+    const float scaled_bottom_price = ScalePolicy::Apply(cfg_->bottom_price);
+    const float y_per_price = height / ScalePolicy::Apply(cfg_->top_price);
 
-    const float scaled_price = utils::ApplyScale(cfg_->scale, price);
-    const float scaled_bottom_price = utils::ApplyScale(cfg_->scale,
-            cfg_->bottom_price);
-    const float scaled_top_price = utils::ApplyScale(cfg_->scale,
-            cfg_->top_price);
+    ScalePolicy::ApplyBatch(prices.data(), prices.size());
 
-    return (cfg_->height - (scaled_price - scaled_bottom_price)
-            * cfg_->height / scaled_top_price);
+    for (float & price : prices)
+        price = height - (price - scaled_bottom_price) * y_per_price;
 }
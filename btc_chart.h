@@ -3,40 +3,74 @@
 #include "utils.h"
 #include "img.h"
 #include "btc_data.h"
+#include "dataset.h"
 
 /**
  * Bitcoin chart class.
  */
 class BtcChart {
 public:
+    /// Price drawing modes enumeration.
+    enum PriceMode {
+        kAvgPrice, ///< Line through the average price of each column.
+        kEnvelopePrice ///< First, min, max and last prices of each column.
+    };
+
     // Bitcoin chart config data structure.
     struct Cfg {
         int width, height; // Chart image size.
-        // First and last days represented in the chart.
-        int day_a, day_b;
+        // First and last times represented in the chart, in seconds since
+        // 1970-01-01 00:00:00 UTC.
+        int64_t time_a, time_b;
         // Bottom and top prices represented in the chart.
         float bottom_price, top_price;
         utils::Scale scale; // Scale of y value in chart.
+        PriceMode price_mode; // How prices of each column are drawn.
+        int num_threads; // Threads used to draw and encode the image.
+        // Exchanges whose prices are drawn, where 'all' stands for every
+        // exchange, or none to draw the price averaged across exchanges.
+        std::vector<std::string> exchanges;
+        // Statistic of the prices of the exchanges at each time.
+        BtcData::ExchangeStat exchange_stat = BtcData::kMeanPrice;
+        // Dataset column drawn instead of the price, such as 'volume' or
+        // 'block_time', or empty to draw the price. The bottom and top
+        // prices are then the bottom and top values of the column.
+        std::string series;
 
         // constructor
         Cfg(const int width, const int height,
-                const int day_a, const int day_b,
+                const int64_t time_a, const int64_t time_b,
                 const float bottom_price, const float top_price,
-                const utils::Scale scale);
+                const utils::Scale scale,
+                const PriceMode price_mode = kAvgPrice,
+                const int num_threads = 1);
     };
 
+    // constructor
+    explicit BtcChart(std::shared_ptr<const BtcData> btc_data,
+            std::shared_ptr<const Dataset> dataset = nullptr);
+
     // public functions
     void Generate(const std::string & path, Cfg & cfg);
 
 private:
-    BtcData btc_data_; ///< BtcData object.
+    static const utils::RGBA kPriceColor_;
+
+    /// Shared, immutable BtcData snapshot.
+    std::shared_ptr<const BtcData> btc_data_;
+    /// Shared, immutable dataset of other series, or null.
+    std::shared_ptr<const Dataset> dataset_;
 
     Cfg * cfg_; ///< Pointer to current chart config.
 
     // private functions
-    void DrawPrice(Img & img);
+    template <typename ScalePolicy> void Draw(Img & img);
+    template <typename ScalePolicy> void DrawPrice(Img & img);
+    template <typename ScalePolicy> void DrawPriceEnvelope(Img & img);
+    void AddPriceRun(Img & img, std::vector<Img::Point> & run);
+    std::vector<BtcData::ColumnPrices> ResampleColumns();
 
     // utility private functions
-    int XToDay(const int x);
-    float PriceToY(const float price);
+    template <typename ScalePolicy>
+    void PricesToY(std::vector<float> & prices);
 };
@@ -1,58 +1,308 @@
+#include <algorithm>
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include "mapped_file.h"
+#include "price_cache.h"
+#include "range_kernels.h"
+#include "thread_pool.h"
 #include "btc_data.h"
 
 
-/// Bitcoin data CSV file path.
-const std::string BtcData::kDataFilePath_ = "data/bitcoinity_price.csv";
+/// Default Bitcoin data CSV file path.
+const std::string BtcData::kDefaultDataFilePath_ =
+    "data/bitcoinity_price.csv";
 
-/// Days from genesis block to first day in data file.
-/// Genesis block was on 2009-01-09.
-const int BtcData::kInitialDaysSinceGen_ = 554;
+/// Suffix added to the CSV file path to get the path of its binary cache
+/// file, which is written next to it.
+const std::string BtcData::kCacheFileSuffix_ = ".cache";
+
+/// Date of genesis block, from which days are counted.
+const utils::Date BtcData::kGenesisDate_ = {2009, 1, 9};
+
+static_assert(utils::DaysFromCivil({2010, 7, 17})
+        - utils::DaysFromCivil({2009, 1, 9}) == 554,
+        "first day in data file is 554 days after genesis block");
+
+/// Seconds per day.
+const int64_t BtcData::kSecondsPerDay_ = 24 * 60 * 60;
+
+/// Maximum time steps from the first time to the last time per row of a
+/// block for which positions of times are looked up in a dense offset
+/// table. Sparser blocks are binary-searched instead.
+const int BtcData::kMaxTimeOffsetsPerRow_ = 4;
+
+/// Rows per block, a multiple of 64 so blocks start at whole words of the
+/// validity bitmaps, as needed by the cache file records. Blocks of 4096
+/// rows fill the coarsest level of their aggregate pyramids.
+const size_t BtcData::kBlockRows_ = 4096;
+
+namespace {
+
+/// Mutex guarding the registry of shared Bitcoin data snapshots.
+std::mutex registry_mutex;
+
+/// Registry of shared Bitcoin data snapshots, by CSV file path.
+std::map<std::string, std::shared_ptr<const BtcData>> registry;
+
+}
+
+/// Rows per chart column from which resampling queries the aggregate
+/// pyramid instead of sweeping over every row.
+const int BtcData::kMinPyramidRowsPerColumn_ = 32;
+
+/// Minimum bytes of the CSV file per chunk extracted in parallel.
+const size_t BtcData::kMinChunkBytes_ = 1024 * 1024;
 
 /**
  * Constructor.
- * Extracts data from file.
+ * Loads data from the binary cache file if it is up to date with the CSV
+ * file. Otherwise extracts data from the CSV file, which is memory-mapped
+ * and scanned in place by several threads, and writes a new cache file.
+ *
+ * Rows of the CSV file are keyed by their date and time, so they can have
+ * gaps and be out of order. When a time has several rows, the last one is
+ * kept.
+ *
+ * @param data_file_path Bitcoin data CSV file path, or an empty path for
+ * empty data to be filled with Append().
+ * @param is_compressed Whether sealed blocks keep their times and prices
+ * compressed, to save memory at the cost of decoding them in queries.
  */
-BtcData::BtcData() {
+BtcData::BtcData(const std::string & data_file_path,
+        const bool is_compressed)
+    : data_file_path_(data_file_path), is_compressed_(is_compressed) {
 
-    std::ifstream file(kDataFilePath_);
+    if (data_file_path_.empty())
+        return;
 
-    if (file.is_open()) {
+    PriceCache::Stamp stamp;
+    const bool is_stamped = PriceCache::StampFile(data_file_path_, stamp);
 
-        std::string line;
+    if (is_stamped && LoadCache(stamp)) {
+        stamp_ = stamp;
+        parsed_bytes_ = stamp.size;
+        parsed_hash_ = stamp.hash;
+        has_partial_line_ = !stamp.ends_with_newline;
+        BuildIndexes();
+        return;
+    }
 
-        getline(file, line); // gets first line (titles line)
+    MappedFile file(data_file_path_);
 
-        // extracts data from the rest of lines
-        for (int i = 0; getline(file, line); i++) {
-            auto day_btc_data = ExtractDayBtcData(line);
-            day_btc_data.days_since_gen = kInitialDaysSinceGen_ + i;
-            btc_data_.push_back(day_btc_data);
-        }
+    if (file.IsOpen()) {
 
-        file.close();
+        ExtractChunks(file.View());
+        SortRows();
+        parsed_hash_ = PriceCache::HashEnds(file.View().substr(0,
+                    parsed_bytes_));
+
+        BuildIndexes();
+
+        if (is_stamped) {
+            stamp_ = stamp;
+            SaveCache(stamp);
+        }
 
     } else {
-        std::cerr << "Error: could not open " << kDataFilePath_ << '\n';
+        std::cerr << "Error: could not open " << data_file_path_ << '\n';
+    }
+}
+
+/**
+ * Gets the shared snapshot of the Bitcoin data of a CSV file, from a
+ * process-wide registry. The data is loaded by the first call for each
+ * file, and every later call returns the same immutable snapshot, which
+ * can be read from many threads without locking, until a new one is
+ * published.
+ *
+ * @param data_file_path Bitcoin data CSV file path.
+ * @param is_compressed Whether sealed blocks keep their times and prices
+ * compressed, used only by the call that loads the data.
+ * @return Shared Bitcoin data snapshot.
+ */
+std::shared_ptr<const BtcData> BtcData::Get(
+        const std::string & data_file_path, const bool is_compressed) {
+
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        const auto it = registry.find(data_file_path);
+        if (it != registry.end())
+            return it->second;
+    }
+
+    // loads without locking, so other files can be loaded meanwhile
+    auto btc_data = std::make_shared<const BtcData>(data_file_path,
+            is_compressed);
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    return registry.emplace(data_file_path, btc_data).first->second;
+}
+
+/**
+ * Publishes a new snapshot of the Bitcoin data of its CSV file in the
+ * process-wide registry, replacing the previous one. Holders of the
+ * previous snapshot keep using it until they release it.
+ *
+ * @param btc_data New Bitcoin data snapshot.
+ */
+void BtcData::Publish(std::shared_ptr<const BtcData> btc_data) {
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    registry[btc_data->data_file_path_] = std::move(btc_data);
+}
+
+/**
+ * Reloads a snapshot of Bitcoin data from its CSV file. When rows have
+ * only been appended to the file, just the new rows are appended to a copy
+ * of the snapshot, which shares its sealed blocks, extending its indexes
+ * incrementally, and to its cache file. When the file has been rewritten,
+ * or the new rows are not after the last row, it is loaded again from
+ * scratch.
+ *
+ * The file is taken as rewritten when it is a new file (another inode),
+ * it is smaller than the extracted bytes, or the first and last extracted
+ * bytes have changed. Rewrites in place that keep both ends of the
+ * extracted bytes are not detected.
+ *
+ * @param btc_data Current Bitcoin data snapshot.
+ * @return New snapshot, or the current one if the file has not changed.
+ */
+std::shared_ptr<const BtcData> BtcData::Reload(
+        const std::shared_ptr<const BtcData> & btc_data) {
+
+    PriceCache::Stamp stamp;
+    if (!PriceCache::StampFile(btc_data->data_file_path_, stamp))
+        return btc_data;
+
+    const PriceCache::Stamp & prev_stamp = btc_data->stamp_;
+    if (stamp.size == prev_stamp.size && stamp.mtime_ns == prev_stamp.mtime_ns
+            && stamp.hash == prev_stamp.hash)
+        return btc_data;
+
+    if (stamp.inode != prev_stamp.inode || btc_data->has_partial_line_)
+        return std::make_shared<const BtcData>(btc_data->data_file_path_,
+                btc_data->is_compressed_);
+
+    MappedFile file(btc_data->data_file_path_);
+    if (!file.IsOpen())
+        return btc_data;
+
+    // rows are only appended to the indexes when the extracted rows are
+    // still there, and rebuilt from scratch otherwise
+    if (!btc_data->IsExtractedPrefix(file.View()))
+        return std::make_shared<const BtcData>(btc_data->data_file_path_,
+                btc_data->is_compressed_);
+
+    auto next = std::make_shared<BtcData>(*btc_data);
+    next->stamp_ = stamp;
+    if (!next->ExtractLines(file.View(), false, true))
+        return std::make_shared<const BtcData>(btc_data->data_file_path_,
+                btc_data->is_compressed_);
+
+    if (next->GetNumRows() == btc_data->GetNumRows())
+        return btc_data;
+
+    next->parsed_hash_ = PriceCache::HashEnds(file.View().substr(0,
+                next->parsed_bytes_));
+
+    next->AppendCache(prev_stamp, btc_data->GetNumRows(), stamp);
+
+    return next;
+}
+
+/**
+ * Appends one row of data after the last row, extending the columns and
+ * the indexes of the last block incrementally, in constant amortized time.
+ * There can be a gap of missing times before it, but rows at the last
+ * time or earlier are rejected, since columns are sorted by time.
+ *
+ * Snapshots shared with Get() must not be modified, so data is appended
+ * to new or copied instances, before sharing them. Copies share every
+ * sealed block, so appending to one does not change the others.
+ *
+ * @param time_btc_data Bitcoin data at one time, with a negative price if
+ * there is no price data for that time.
+ * @param exchange_prices Prices of every exchange of GetExchanges() at
+ * that time, negative for exchanges without data, or null if there is no
+ * data of any exchange.
+ * @return True if the row was appended, false if its time is not after
+ * the last time.
+ */
+bool BtcData::Append(const TimeBtcData & time_btc_data,
+        const float * exchange_prices) {
+
+    const size_t num_rows = GetNumRows();
+
+    if (num_rows > 0 && time_btc_data.time <= GetLastTime())
+        return false;
+
+    if (num_rows > 0)
+        time_step_ = std::gcd(time_step_,
+                time_btc_data.time - GetLastTime());
+
+    PushRow(time_btc_data, exchange_prices);
+
+    Columns & columns = tail_.columns;
+    tail_.price_pyramid.Append(columns.prices.data(), columns.valid,
+            columns.prices.size());
+
+    if (columns.times.size() == kBlockRows_)
+        SealTail();
+
+    return true;
+}
+
+/**
+ * Appends the rows of some CSV lines, in the format of the data file
+ * without its titles line, stopping at the first row that is not after
+ * the last row, or the first row without a valid time.
+ *
+ * @param lines View of CSV lines.
+ * @return Number of rows appended.
+ */
+size_t BtcData::AppendCsv(std::string_view lines) {
+
+    size_t num_rows = 0;
+    std::vector<float> exchange_prices(exchanges_.size());
+
+    while (!lines.empty()) {
+
+        const size_t eol = std::min(lines.find('\n'), lines.size());
+        const std::string_view line = lines.substr(0, eol);
+        lines.remove_prefix(std::min(eol + 1, lines.size()));
+
+        if (line.empty() || line == "\r")
+            continue;
+
+        TimeBtcData time_btc_data;
+        if (!ExtractTimeBtcData(line, time_btc_data, exchange_prices.data(),
+                    exchange_prices.size())
+                || !Append(time_btc_data, exchange_prices.data())) {
+            std::cerr << "Error: could not append " << line << '\n';
+            break;
+        }
+        num_rows++;
     }
+
+    return num_rows;
 }
 
 /**
  * Gets Bitcoin price on a specific day or -1 if there is no data to get
- * the price from
+ * the price from. It is the average price of the day, which for daily
+ * data is the price of its row.
  *
  * @param days_since_gen Days since genesis block to day which price has
  * to be returned.
  * @return Price or -1.
  */
-float BtcData::GetPrice(const int days_since_gen) {
+float BtcData::GetPrice(const int days_since_gen) const {
 
-    return ((days_since_gen - kInitialDaysSinceGen_ >= int(btc_data_.size())
-                || days_since_gen < kInitialDaysSinceGen_)
-            ? -1.0f
-            : btc_data_[days_since_gen - kInitialDaysSinceGen_].price);
+    return GetAvgPrice(days_since_gen, days_since_gen + 1);
 }
 
 /**
@@ -63,23 +313,24 @@ float BtcData::GetPrice(const int days_since_gen) {
  * @param day_b Second day, counted as number of days since genesis block.
  * @return Average price or -1.
  */
-float BtcData::GetAvgPrice(const int day_a, const int day_b) {
+float BtcData::GetAvgPrice(const int day_a, const int day_b) const {
 
-    int num_days = 0;
-    float avg_price = 0.0f;
+    const auto bucket = AggregateDays(day_a, day_b);
 
-    for (int day = day_a; day < day_b; day++) {
-
-        const int i = day - kInitialDaysSinceGen_;
-
-        if (i < 0 || i >= int(btc_data_.size()) || btc_data_[i].price < 0)
-            continue;
+    return (bucket.count == 0) ? -1.0f : float(bucket.sum / bucket.count);
+}
 
-        num_days++;
-        avg_price += btc_data_[i].price;
-    }
+/**
+ * Gets minimum price between two days or -1 if there is no data to get
+ * the price from.
+ *
+ * @param day_a First day, counted as number of days since genesis block.
+ * @param day_b Second day, counted as number of days since genesis block.
+ * @return Minimum price or -1.
+ */
+float BtcData::GetMinPrice(const int day_a, const int day_b) const {
 
-    return ((num_days == 0) ? -1.0f : avg_price / num_days);
+    return AggregateDays(day_a, day_b).low;
 }
 
 /**
@@ -89,19 +340,372 @@ float BtcData::GetAvgPrice(const int day_a, const int day_b) {
  * @param day_b Second day, counted as number of days since genesis block.
  * @return Maximum price.
  */
-float BtcData::GetMaxPrice(const int day_a, const int day_b) {
+float BtcData::GetMaxPrice(const int day_a, const int day_b) const {
 
-    float max_price = 0.0f;
+    return std::max(0.0f, AggregateDays(day_a, day_b).high);
+}
 
-    for (int day = day_a; day < day_b; day++) {
-        const int i = day - kInitialDaysSinceGen_;
-        if (i < 0 || i >= int(btc_data_.size()) || btc_data_[i].price < 0)
-            continue;
-        if (btc_data_[i].price > max_price)
-            max_price = btc_data_[i].price;
+/**
+ * Gets number of rows with price data between two days, which for daily
+ * data is the number of days with price data.
+ *
+ * @param day_a First day, counted as number of days since genesis block.
+ * @param day_b Second day, counted as number of days since genesis block.
+ * @return Number of rows with price data.
+ */
+int BtcData::GetNumDays(const int day_a, const int day_b) const {
+
+    return int(AggregateDays(day_a, day_b).count);
+}
+
+/**
+ * Gets price statistics between two days, computed with vectorized range
+ * kernels in a single pass over the prices of each block, decoded first
+ * if compressed.
+ *
+ * @param day_a First day, counted as number of days since genesis block.
+ * @param day_b Second day, counted as number of days since genesis block.
+ * @return Price statistics.
+ */
+BtcData::PriceStats BtcData::GetStats(const int day_a, const int day_b)
+    const {
+
+    PriceStats price_stats;
+    kernels::RangeStats stats;
+    Decoded decoded;
+
+    ForEachBlock(IndexOfTime(TimeOfDay(day_a), decoded),
+            IndexOfTime(TimeOfDay(day_b), decoded),
+            [&](const Block & block, const size_t a, const size_t b,
+                const size_t) {
+
+        const Columns & columns = GetRows(block, decoded);
+        const auto block_stats = kernels::Reduce(columns.prices.data(),
+                columns.valid.Words(), a, b);
+
+        if (block_stats.count == 0)
+            return;
+
+        if (stats.count == 0) {
+            stats.min = block_stats.min;
+            stats.max = block_stats.max;
+            price_stats.first = columns.prices[block_stats.first];
+        } else {
+            stats.min = std::min(stats.min, block_stats.min);
+            stats.max = std::max(stats.max, block_stats.max);
+        }
+        price_stats.last = columns.prices[block_stats.last];
+
+        stats.count += block_stats.count;
+        stats.sum += block_stats.sum;
+        stats.sum_sq += block_stats.sum_sq;
+    });
+
+    if (stats.count == 0)
+        return price_stats;
+
+    const double avg = stats.sum / stats.count;
+    const double variance = std::max(0.0, stats.sum_sq / stats.count
+            - avg * avg);
+
+    price_stats.num_days = int(stats.count);
+    price_stats.avg = float(avg);
+    price_stats.stddev = float(std::sqrt(variance));
+    price_stats.min = stats.min;
+    price_stats.max = stats.max;
+
+    return price_stats;
+}
+
+/**
+ * Gets open (first), high, low and close (last) prices, and the sum and
+ * number of prices, between two days, from the aggregate pyramids, or the
+ * summaries of compressed blocks.
+ *
+ * @param day_a First day, counted as number of days since genesis block.
+ * @param day_b Second day, counted as number of days since genesis block.
+ * @return Aggregates of prices.
+ */
+AggregatePyramid::Bucket BtcData::GetOhlc(const int day_a, const int day_b)
+    const {
+
+    return AggregateDays(day_a, day_b);
+}
+
+/**
+ * Aggregates prices between two times into columns of a chart. Column x
+ * aggregates the rows from the time at x - 1 to the time at x, with the
+ * time at x being time_a + x * (time_b - time_a) / width, rounded towards
+ * time_a to whole time steps of the data.
+ *
+ * @param time_a First time, in seconds since 1970-01-01 00:00:00 UTC.
+ * @param time_b Second time, in seconds since 1970-01-01 00:00:00 UTC.
+ * @param width Number of columns.
+ * @return Aggregated prices of each column.
+ */
+std::vector<BtcData::ColumnPrices> BtcData::Resample(const int64_t time_a,
+        const int64_t time_b, const int width) const {
+
+    Decoded decoded;
+
+    return AggregateRanges(ColumnBounds(time_a, time_b, width, decoded),
+            decoded);
+}
+
+/**
+ * Aggregates prices between two times into buckets of a fixed size, such
+ * as a minute, an hour, a day or a week. Bucket k aggregates the rows in
+ * [time_a + k * bucket_size, time_a + (k + 1) * bucket_size).
+ *
+ * @param time_a First time, in seconds since 1970-01-01 00:00:00 UTC.
+ * @param time_b Second time, in seconds since 1970-01-01 00:00:00 UTC.
+ * @param bucket_size Seconds per bucket.
+ * @return Aggregated prices of each bucket.
+ */
+std::vector<BtcData::ColumnPrices> BtcData::ResampleBuckets(
+        const int64_t time_a, const int64_t time_b,
+        const int64_t bucket_size) const {
+
+    if (bucket_size <= 0 || time_b <= time_a)
+        return std::vector<ColumnPrices>();
+
+    const int64_t num_buckets = (time_b - time_a + bucket_size - 1)
+        / bucket_size;
+    std::vector<size_t> bounds(num_buckets + 1);
+    Decoded decoded;
+
+    for (int64_t k = 0; k <= num_buckets; k++)
+        bounds[k] = IndexOfTime(time_a + k * bucket_size, decoded);
+
+    return AggregateRanges(bounds, decoded);
+}
+
+/**
+ * Aggregates a statistic of the prices of some exchanges between two times
+ * into columns of a chart, like Resample(). The statistic is computed for
+ * every row across the exchanges with vectorized row-wise kernels, and
+ * the resulting series is aggregated into the columns.
+ *
+ * @param time_a First time, in seconds since 1970-01-01 00:00:00 UTC.
+ * @param time_b Second time, in seconds since 1970-01-01 00:00:00 UTC.
+ * @param width Number of columns.
+ * @param exchange_ids Positions in GetExchanges() of the exchanges, where
+ * unknown positions are skipped.
+ * @param exchange_stat Statistic of the prices of each row.
+ * @return Aggregated statistic of each column.
+ */
+std::vector<BtcData::ColumnPrices> BtcData::ResampleExchanges(
+        const int64_t time_a, const int64_t time_b, const int width,
+        const std::vector<int> & exchange_ids,
+        const ExchangeStat exchange_stat) const {
+
+    Decoded decoded;
+    const std::vector<size_t> bounds = ColumnBounds(time_a, time_b, width,
+            decoded);
+    std::vector<ColumnPrices> columns(
+            bounds.empty() ? 0 : bounds.size() - 1);
+
+    if (columns.empty())
+        return columns;
+
+    std::vector<int> ids;
+    for (const int id : exchange_ids)
+        if (id >= 0 && id < int(exchanges_.size()))
+            ids.push_back(id);
+
+    // statistic of every row from the first to the last column, block by
+    // block
+    const size_t a = bounds[0];
+    const size_t b = *std::max_element(bounds.begin(), bounds.end());
+
+    std::vector<float> stats(b - a), mins(b - a), maxs(b - a);
+    std::vector<const float *> exchange_prices(ids.size());
+    std::vector<const uint64_t *> exchange_valid(ids.size());
+
+    ForEachBlock(a, b, [&](const Block & block, const size_t block_a,
+                const size_t block_b, const size_t first_row) {
+
+        for (size_t k = 0; k < ids.size(); k++) {
+            exchange_prices[k] = block.columns.exchange_prices[ids[k]].data();
+            exchange_valid[k] = block.columns.exchange_valid[ids[k]].Words();
+        }
+
+        const size_t offset = first_row + block_a - a;
+
+        if (exchange_stat == kMedianPrice)
+            kernels::MedianRows(exchange_prices.data(),
+                    exchange_valid.data(), ids.size(), block_a, block_b,
+                    stats.data() + offset);
+        else
+            kernels::ReduceRows(exchange_prices.data(),
+                    exchange_valid.data(), ids.size(), block_a, block_b,
+                    stats.data() + offset, mins.data() + offset,
+                    maxs.data() + offset);
+    });
+
+    if (exchange_stat == kMinPrice)
+        stats.swap(mins);
+    else if (exchange_stat == kMaxPrice)
+        stats.swap(maxs);
+    else if (exchange_stat == kSpreadPrice)
+        for (size_t i = 0; i < stats.size(); i++)
+            stats[i] = (stats[i] < 0) ? -1.0f : maxs[i] - mins[i];
+
+    Bitmap valid;
+    valid.Assign(stats.size(), false);
+    for (size_t i = 0; i < stats.size(); i++)
+        valid.Set(i, stats[i] >= 0);
+
+    size_t i = a;
+
+    for (size_t x = 0; x < columns.size(); x++) {
+        const size_t end = bounds[x + 1];
+        if (end > i)
+            SweepRange(stats.data(), valid, i - a, end - a, columns[x]);
+        i = std::max(i, end);
     }
 
-    return max_price;
+    return columns;
+}
+
+/**
+ * Gets names of the exchanges, from the titles line of the CSV file.
+ *
+ * @return Exchange names, in the order of the CSV file.
+ */
+const std::vector<std::string> & BtcData::GetExchanges() const {
+
+    return exchanges_;
+}
+
+/**
+ * Gets position of an exchange in GetExchanges().
+ *
+ * @param exchange Exchange name.
+ * @return Position of the exchange, or -1 if there is no such exchange.
+ */
+int BtcData::GetExchangeId(const std::string & exchange) const {
+
+    const auto it = std::find(exchanges_.begin(), exchanges_.end(),
+            exchange);
+
+    return (it == exchanges_.end()) ? -1 : int(it - exchanges_.begin());
+}
+
+/**
+ * Encodes the averaged prices into a compressed time series, for example
+ * to store or send them. The series is a copy of the data, which keeps
+ * its own columns, or its own compressed blocks in compressed mode, so
+ * the memory used is only saved by loading the data in compressed mode.
+ *
+ * @return Compressed time series of prices.
+ */
+CompressedSeries BtcData::Compress() const {
+
+    CompressedSeries series;
+    Decoded decoded;
+
+    for (size_t k = 0; k <= blocks_.size(); k++) {
+        const Columns & columns = GetRows(GetBlock(k), decoded);
+        for (size_t i = 0; i < columns.times.size(); i++)
+            series.Append(columns.times[i], columns.prices[i],
+                    columns.valid.Test(i));
+    }
+
+    return series;
+}
+
+/**
+ * Gets position of the first row of a day or a later day, or the number of
+ * rows if there is none, so that the days in [day_a, day_b) are at
+ * positions [IndexOfDay(day_a), IndexOfDay(day_b)).
+ *
+ * @param day Day, counted as number of days since genesis block.
+ * @return Position of the day.
+ */
+size_t BtcData::IndexOfDay(const int day) const {
+
+    return IndexOfTime(TimeOfDay(day));
+}
+
+/**
+ * Gets position of the first row at a time or later, or the number of
+ * rows if there is none, so that the times in [time_a, time_b) are at
+ * positions [IndexOfTime(time_a), IndexOfTime(time_b)). Its block is
+ * binary-searched, and it is computed from the time step of the block in
+ * constant time if the block has a row at every time step, looked up in
+ * the offset table of the block, or binary-searched if the block is
+ * sparse or compressed.
+ *
+ * @param time Time, in seconds since 1970-01-01 00:00:00 UTC.
+ * @return Position of the time.
+ */
+size_t BtcData::IndexOfTime(const int64_t time) const {
+
+    Decoded decoded;
+
+    return IndexOfTime(time, decoded);
+}
+
+/**
+ * Gets position of the first row at a time or later, like the public
+ * IndexOfTime(), decoding the times of a compressed block with gaps only
+ * if it is not decoded yet.
+ *
+ * @param time Time, in seconds since 1970-01-01 00:00:00 UTC.
+ * @param decoded Last block decoded by the query.
+ * @return Position of the time.
+ */
+size_t BtcData::IndexOfTime(const int64_t time, Decoded & decoded) const {
+
+    const size_t num_rows = GetNumRows();
+
+    if (num_rows == 0 || time <= GetFirstTime(GetBlock(0)))
+        return 0;
+    if (time > GetLastTime())
+        return num_rows;
+
+    // the first block ending at the time or later has the row
+    const size_t k = size_t(std::partition_point(blocks_.begin(),
+                blocks_.end(), [&](const std::shared_ptr<const Block> & b) {
+                    return GetLastTime(*b) < time;
+                }) - blocks_.begin());
+
+    const Block & block = GetBlock(k);
+    const int64_t first_time = GetFirstTime(block);
+    const size_t first_row = k * kBlockRows_;
+
+    if (time <= first_time)
+        return first_row;
+
+    // every row is on a time step, so the first row at the next time step
+    // is the first row at the time or later, and with a row at every time
+    // step it is that many rows after the first one
+    const int64_t step = block.time_step;
+    if (step > 0 && (GetLastTime(block) - first_time) / step + 1
+            == int64_t(kBlockRows_))
+        return first_row + size_t((time - first_time + step - 1) / step);
+
+    if (!block.time_offsets.empty())
+        return first_row + block.time_offsets[(time - first_time + step - 1)
+            / step];
+
+    const std::vector<int64_t> & times = GetRows(block, decoded).times;
+
+    return first_row + size_t(std::lower_bound(times.begin(), times.end(),
+                time) - times.begin());
+}
+
+/**
+ * Gets time at the start of a day.
+ *
+ * @param day Day, counted as number of days since genesis block.
+ * @return Time, in seconds since 1970-01-01 00:00:00 UTC.
+ */
+int64_t BtcData::TimeOfDay(const int day) {
+
+    return (int64_t(utils::DaysFromCivil(kGenesisDate_)) + day)
+        * kSecondsPerDay_;
 }
 
 /**
@@ -109,106 +713,882 @@ float BtcData::GetMaxPrice(const int day_a, const int day_b) {
  *
  * @return Last day of data.
  */
-int BtcData::GetLastDay() {
+int BtcData::GetLastDay() const {
 
-    return btc_data_.rbegin()->days_since_gen;
+    const int64_t seconds = GetLastTime() - TimeOfDay(0);
+
+    return int(seconds / kSecondsPerDay_
+            - (seconds % kSecondsPerDay_ < 0 ? 1 : 0));
 }
 
 /**
- * Extracts one day Bitcoin data from one line of the data file.
+ * Gets time of the last row of data.
  *
- * @param line String containg data from one line of the data file.
- * @return One day Bitcoin data.
+ * @return Time, in seconds since 1970-01-01 00:00:00 UTC.
  */
-BtcData::DayBtcData BtcData::ExtractDayBtcData(const std::string & line) {
+int64_t BtcData::GetLastTime() const {
 
-    DayBtcData day_btc_data;
+    return tail_.columns.times.empty() ? GetLastTime(*blocks_.back())
+        : tail_.columns.times.back();
+}
 
-    std::stringstream line_ss;
-    line_ss << line;
+/**
+ * Gets number of rows of data.
+ *
+ * @return Number of rows.
+ */
+size_t BtcData::GetNumRows() const {
 
-    for (int i = 0; !line_ss.eof(); i++) {
+    return blocks_.size() * kBlockRows_ + tail_.columns.times.size();
+}
+
+/**
+ * Counts the first blocks of rows shared with another instance, as done by
+ * copies of an instance, which only copy the rows that are not in a
+ * sealed block yet.
+ *
+ * @param other Other Bitcoin data.
+ * @return Number of sealed blocks stored once for both instances.
+ */
+size_t BtcData::CountSharedBlocks(const BtcData & other) const {
 
-        std::string word;
-        line_ss >> word; // exctracts until space
+    size_t k = 0;
+    while (k < std::min(blocks_.size(), other.blocks_.size())
+            && blocks_[k] == other.blocks_[k])
+        k++;
 
-        switch (i) {
-        case 0:
-            day_btc_data.date = ExtractDate(word);
-            break;
-        case 2:
-            day_btc_data.price = ExtractAveragePrice(word);
-            break;
+    return k;
+}
+
+/**
+ * Gets bytes of memory used by the rows and indexes of every block,
+ * including those shared with other instances.
+ *
+ * @return Bytes of memory.
+ */
+size_t BtcData::MemoryBytes() const {
+
+    size_t bytes = 0;
+
+    for (size_t k = 0; k <= blocks_.size(); k++) {
+
+        const Block & block = GetBlock(k);
+        const Columns & columns = block.columns;
+
+        bytes += columns.times.size() * sizeof(int64_t)
+            + columns.prices.size() * sizeof(float)
+            + columns.valid.NumWords() * sizeof(uint64_t);
+
+        for (size_t e = 0; e < columns.exchange_prices.size(); e++)
+            bytes += columns.exchange_prices[e].size() * sizeof(float)
+                + columns.exchange_valid[e].NumWords() * sizeof(uint64_t);
+
+        bytes += block.time_offsets.size() * sizeof(uint32_t)
+            + block.price_pyramid.MemoryBytes() + block.series.MemoryBytes();
+    }
+
+    return bytes;
+}
+
+/**
+ * Builds the blocks and their indexes from loaded data, which is all in
+ * the last block until then.
+ */
+void BtcData::BuildIndexes() {
+
+    const Columns rows = std::move(tail_.columns);
+    const size_t num_rows = rows.times.size();
+
+    ClearTail();
+
+    time_step_ = 0;
+    for (size_t i = 1; i < num_rows; i++)
+        time_step_ = std::gcd(time_step_, rows.times[i] - rows.times[i - 1]);
+
+    // blocks start at multiples of 64 rows, so at whole bitmap words
+    for (size_t a = 0; a < num_rows; a += kBlockRows_) {
+
+        const size_t b = std::min(a + kBlockRows_, num_rows);
+        Columns & columns = tail_.columns;
+
+        columns.times.assign(rows.times.begin() + a, rows.times.begin() + b);
+        columns.prices.assign(rows.prices.begin() + a,
+                rows.prices.begin() + b);
+        columns.valid.AssignWords(rows.valid.Words() + a / 64, b - a);
+
+        for (size_t k = 0; k < exchanges_.size(); k++) {
+            columns.exchange_prices[k].assign(
+                    rows.exchange_prices[k].begin() + a,
+                    rows.exchange_prices[k].begin() + b);
+            columns.exchange_valid[k].AssignWords(
+                    rows.exchange_valid[k].Words() + a / 64, b - a);
+        }
+
+        // compressed blocks are sealed without aggregate pyramid
+        if (!is_compressed_ || b - a < kBlockRows_)
+            tail_.price_pyramid.Build(columns.prices.data(), columns.valid,
+                    b - a);
+
+        if (b - a == kBlockRows_)
+            SealTail();
+    }
+}
+
+/**
+ * Seals the last block, once full, and starts a new empty last block. Its
+ * offset table is built with the position of each time step from its
+ * first time to its last time, if its rows are dense enough but for a row
+ * at every time step. In compressed mode, its times and prices are
+ * encoded into its compressed series instead, without offset table.
+ */
+void BtcData::SealTail() {
+
+    Columns & columns = tail_.columns;
+    const std::vector<int64_t> & times = columns.times;
+
+    tail_.time_step = 0;
+    for (size_t i = 1; i < times.size(); i++)
+        tail_.time_step = std::gcd(tail_.time_step, times[i] - times[i - 1]);
+
+    tail_.time_offsets.clear();
+
+    const int64_t num_steps = (tail_.time_step == 0) ? 0
+        : (times.back() - times.front()) / tail_.time_step + 1;
+
+    if (!is_compressed_ && num_steps > int64_t(times.size())
+            && num_steps <= int64_t(kMaxTimeOffsetsPerRow_ * times.size())) {
+
+        tail_.time_offsets.reserve(num_steps);
+
+        size_t i = 0;
+        for (int64_t k = 0; k < num_steps; k++) {
+            while (times[i] < times.front() + k * tail_.time_step)
+                i++;
+            tail_.time_offsets.push_back(uint32_t(i));
         }
     }
 
-    return day_btc_data;
+    if (is_compressed_) {
+        for (size_t i = 0; i < times.size(); i++)
+            tail_.series.Append(times[i], columns.prices[i],
+                    columns.valid.Test(i));
+        columns.times = std::vector<int64_t>();
+        columns.prices = std::vector<float>();
+        columns.valid = Bitmap();
+        tail_.price_pyramid = AggregatePyramid();
+    }
+
+    blocks_.push_back(std::make_shared<const Block>(std::move(tail_)));
+    ClearTail();
+}
+
+/**
+ * Empties the last block, leaving an empty column for every exchange.
+ */
+void BtcData::ClearTail() {
+
+    tail_ = Block();
+    tail_.columns.exchange_prices.resize(exchanges_.size());
+    tail_.columns.exchange_valid.resize(exchanges_.size());
 }
 
 /**
- * Extracts date from string.
+ * Gets a block of rows, where the block after the sealed blocks is the
+ * last block.
  *
- * @param date_str String containg date.
- * @return Date data structure.
+ * @param k Block position, up to the number of sealed blocks.
+ * @return Block of rows [k * kBlockRows_, (k + 1) * kBlockRows_).
  */
-utils::Date BtcData::ExtractDate(const std::string & date_str) {
+const BtcData::Block & BtcData::GetBlock(const size_t k) const {
 
-    utils::Date date;
+    return (k < blocks_.size()) ? *blocks_[k] : tail_;
+}
 
-    std::stringstream date_ss;
-    date_ss << date_str;
+/**
+ * Gets the columns of the times and prices of a block, decoded if the
+ * block is compressed and not the last block decoded by the query.
+ *
+ * @param block Block of rows.
+ * @param decoded Last block decoded by the query, replaced by this block
+ * if it is compressed.
+ * @return Columns of the rows of the block, without exchange columns if
+ * decoded.
+ */
+const BtcData::Columns & BtcData::GetRows(const Block & block,
+        Decoded & decoded) {
 
-    for (int i = 0; !date_ss.eof(); i++) {
+    if (block.series.Size() == 0)
+        return block.columns;
 
-        std::string word;
-        getline(date_ss, word, '-');
+    if (decoded.block != &block) {
+        Columns & columns = decoded.columns;
+        block.series.DecodeBlock(0, columns.times, columns.prices,
+                columns.valid);
+        decoded.block = &block;
+    }
 
-        int number;
-        std::stringstream(word) >> number;
+    return decoded.columns;
+}
 
-        switch (i) {
-        case 0:
-            date.y = number;
-            break;
-        case 1:
-            date.m = number;
-            break;
-        case 2:
-            date.d = number;
-            break;
+/**
+ * Gets time of the first row of a block, which must not be empty.
+ *
+ * @param block Block of rows.
+ * @return Time, in seconds since 1970-01-01 00:00:00 UTC.
+ */
+int64_t BtcData::GetFirstTime(const Block & block) {
+
+    return (block.series.Size() == 0) ? block.columns.times.front()
+        : block.series.GetFirstTime();
+}
+
+/**
+ * Gets time of the last row of a block, which must not be empty.
+ *
+ * @param block Block of rows.
+ * @return Time, in seconds since 1970-01-01 00:00:00 UTC.
+ */
+int64_t BtcData::GetLastTime(const Block & block) {
+
+    return (block.series.Size() == 0) ? block.columns.times.back()
+        : block.series.GetLastTime();
+}
+
+/**
+ * Calls a function for the rows of a range in each block, in order.
+ *
+ * @tparam Function Type of the function, taking the block, the first and
+ * one past last positions of the rows in the block, and the position of
+ * the first row of the block.
+ * @param a,b First and one past last positions of the range.
+ * @param function Function to call.
+ */
+template <typename Function>
+void BtcData::ForEachBlock(size_t a, const size_t b, Function function)
+    const {
+
+    while (a < b) {
+        const size_t first_row = a / kBlockRows_ * kBlockRows_;
+        const size_t end = std::min(b, first_row + kBlockRows_);
+        function(GetBlock(a / kBlockRows_), a - first_row, end - first_row,
+                first_row);
+        a = end;
+    }
+}
+
+/**
+ * Gets aggregates of the prices of a range of rows, combined from the
+ * aggregate pyramids of its blocks, so every full block in the range takes
+ * a single bucket. Compressed blocks in the range take the summary of
+ * their series, and those at its ends are decoded and reduced.
+ *
+ * @param a,b First and one past last positions of the range.
+ * @param decoded Last block decoded by the query.
+ * @return Aggregates of the prices.
+ */
+AggregatePyramid::Bucket BtcData::AggregateRows(const size_t a,
+        const size_t b, Decoded & decoded) const {
+
+    AggregatePyramid::Bucket bucket;
+
+    ForEachBlock(a, b, [&](const Block & block, const size_t block_a,
+                const size_t block_b, const size_t) {
+
+        if (block.series.Size() == 0) {
+            AggregatePyramid::Combine(bucket, block.price_pyramid.Query(
+                        block.columns.prices.data(), block.columns.valid,
+                        block_a, block_b));
+            return;
+        }
+
+        if (block_a == 0 && block_b == block.series.Size()) {
+            AggregatePyramid::Combine(bucket, block.series.Query(
+                        GetFirstTime(block), GetLastTime(block) + 1));
+            return;
+        }
+
+        const Columns & columns = GetRows(block, decoded);
+        const auto stats = kernels::Reduce(columns.prices.data(),
+                columns.valid.Words(), block_a, block_b);
+
+        if (stats.count == 0)
+            return;
+
+        AggregatePyramid::Bucket part;
+        part.open = columns.prices[stats.first];
+        part.high = stats.max;
+        part.low = stats.min;
+        part.close = columns.prices[stats.last];
+        part.sum = stats.sum;
+        part.count = uint32_t(stats.count);
+        AggregatePyramid::Combine(bucket, part);
+    });
+
+    return bucket;
+}
+
+/**
+ * Gets aggregates of the prices between two days, like AggregateRows().
+ *
+ * @param day_a First day, counted as number of days since genesis block.
+ * @param day_b Second day, counted as number of days since genesis block.
+ * @return Aggregates of the prices.
+ */
+AggregatePyramid::Bucket BtcData::AggregateDays(const int day_a,
+        const int day_b) const {
+
+    Decoded decoded;
+    const size_t a = IndexOfTime(TimeOfDay(day_a), decoded);
+
+    return AggregateRows(a, IndexOfTime(TimeOfDay(day_b), decoded),
+            decoded);
+}
+
+/**
+ * Sorts the columns of loaded data, which is all in the last block until
+ * indexes are built, by time, keeping only the last extracted row of each
+ * time, if they are not sorted already.
+ */
+void BtcData::SortRows() {
+
+    const Columns & rows = tail_.columns;
+
+    if (std::adjacent_find(rows.times.begin(), rows.times.end(),
+                [](const int64_t a, const int64_t b) { return a >= b; })
+            == rows.times.end())
+        return;
+
+    std::vector<size_t> order(rows.times.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+            [&](const size_t a, const size_t b) {
+                return rows.times[a] < rows.times[b];
+            });
+
+    Columns sorted;
+    sorted.exchange_prices.resize(exchanges_.size());
+    sorted.exchange_valid.resize(exchanges_.size());
+
+    for (size_t k = 0; k < order.size(); k++) {
+
+        const size_t i = order[k];
+        if (k + 1 < order.size() && rows.times[order[k + 1]] == rows.times[i])
+            continue;
+
+        sorted.times.push_back(rows.times[i]);
+        sorted.prices.push_back(rows.prices[i]);
+        sorted.valid.PushBack(rows.valid.Test(i));
+
+        for (size_t e = 0; e < exchanges_.size(); e++) {
+            sorted.exchange_prices[e].push_back(rows.exchange_prices[e][i]);
+            sorted.exchange_valid[e].PushBack(rows.exchange_valid[e].Test(i));
         }
     }
 
-    return date;
+    tail_.columns = std::move(sorted);
 }
 
 /**
- * Extracts average price from string containing multiple prices separated
- * by commas or -1 if there is no data to get the price from.
+ * Appends one row of data to the columns of the last block.
  *
- * @param prices_str String containg multiple prices separated by commas.
- * @return Average price or -1.
+ * @param time_btc_data Bitcoin data at one time, with a negative price if
+ * there is no price data for that time.
+ * @param exchange_prices Prices of every exchange at that time, negative
+ * for exchanges without data, or null if there is no data of any exchange.
+ */
+void BtcData::PushRow(const TimeBtcData & time_btc_data,
+        const float * exchange_prices) {
+
+    const bool is_valid = time_btc_data.price >= 0;
+    Columns & columns = tail_.columns;
+
+    columns.times.push_back(time_btc_data.time);
+    columns.prices.push_back(is_valid ? time_btc_data.price : 0.0f);
+    columns.valid.PushBack(is_valid);
+
+    for (size_t k = 0; k < exchanges_.size(); k++) {
+        const bool is_valid_k = exchange_prices && exchange_prices[k] >= 0;
+        columns.exchange_prices[k].push_back(
+                is_valid_k ? exchange_prices[k] : 0.0f);
+        columns.exchange_valid[k].PushBack(is_valid_k);
+    }
+}
+
+/**
+ * Extracts names of the exchanges from the titles line of the CSV file,
+ * which are the fields after the time field, and empties their columns.
+ *
+ * @param titles_line View of the titles line.
  */
-float BtcData::ExtractAveragePrice(const std::string & prices_str) {
+void BtcData::ExtractExchanges(std::string_view titles_line) {
+
+    if (!titles_line.empty() && titles_line.back() == '\r')
+        titles_line.remove_suffix(1);
+
+    exchanges_.clear();
+
+    for (size_t comma = titles_line.find(',');
+            comma != std::string_view::npos; ) {
+        const size_t next = titles_line.find(',', comma + 1);
+        exchanges_.emplace_back(titles_line.substr(comma + 1,
+                    std::min(next, titles_line.size()) - comma - 1));
+        comma = next;
+    }
+
+    ClearTail();
+}
 
-    std::stringstream prices_ss;
-    prices_ss << prices_str;
+/**
+ * Checks whether the CSV file still starts with the bytes extracted so
+ * far, so that its new rows can be appended. They must end at a line
+ * break, and their first and last bytes must be unchanged.
+ *
+ * @param contents Current CSV file contents.
+ * @return True if the extracted bytes seem unchanged.
+ */
+bool BtcData::IsExtractedPrefix(std::string_view contents) const {
 
-    std::vector<float> prices;
+    if (contents.size() < parsed_bytes_)
+        return false;
+    if (parsed_bytes_ > 0 && contents[parsed_bytes_ - 1] != '\n')
+        return false;
 
-    for (int i = 0; !prices_ss.eof(); i++) {
+    return PriceCache::HashEnds(contents.substr(0, parsed_bytes_))
+        == parsed_hash_;
+}
 
-        std::string word;
-        getline(prices_ss, word, ',');
+/**
+ * Extracts data from the lines of the CSV file not extracted yet, skipping
+ * its first line (titles line) and lines without a valid time.
+ *
+ * @param contents CSV file contents.
+ * @param extract_partial_line Whether a last line without line break,
+ * which may still be being written, is extracted too.
+ * @param append Whether rows are appended with Append(), extending the
+ * indexes, instead of just pushed to the columns.
+ * @return False if a day could not be appended, true otherwise.
+ */
+bool BtcData::ExtractLines(std::string_view contents,
+        const bool extract_partial_line, const bool append) {
+
+    size_t pos = parsed_bytes_;
+
+    if (pos == 0) {
+        const size_t eol = contents.find('\n');
+        if (eol == std::string_view::npos) {
+            has_partial_line_ = !contents.empty();
+            return true;
+        }
+        ExtractExchanges(contents.substr(0, eol));
+        pos = parsed_bytes_ = eol + 1;
+    }
+
+    std::vector<float> exchange_prices(exchanges_.size());
+
+    while (pos < contents.size()) {
+
+        size_t eol = contents.find('\n', pos);
+        if (eol == std::string_view::npos) {
+            if (!extract_partial_line)
+                break;
+            eol = contents.size();
+            has_partial_line_ = true;
+        }
+
+        TimeBtcData time_btc_data;
+        const bool is_valid_time = ExtractTimeBtcData(
+                contents.substr(pos, eol - pos), time_btc_data,
+                exchange_prices.data(), exchange_prices.size());
+
+        if (is_valid_time && append) {
+            if (!Append(time_btc_data, exchange_prices.data()))
+                return false;
+        } else if (is_valid_time) {
+            PushRow(time_btc_data, exchange_prices.data());
+        }
+
+        pos = eol + 1;
+        if (!has_partial_line_)
+            parsed_bytes_ = pos;
+    }
+
+    return true;
+}
 
-        // the first word is not a price
-        if (i == 0)
+/**
+ * Extracts data from all lines of the CSV file, like ExtractLines(), but
+ * splitting them at line breaks into chunks that are extracted in
+ * parallel on a pool of worker threads, each one into empty data of its
+ * own. The columns of the chunks are then concatenated in file order, so
+ * rows keep the order they would have if extracted sequentially.
+ *
+ * @param contents CSV file contents.
+ */
+void BtcData::ExtractChunks(std::string_view contents) {
+
+    const size_t start = contents.find('\n') + 1;
+    size_t num_chunks = std::min(
+            size_t(ThreadPool::DefaultNumThreads()),
+            (start == 0) ? 0 : (contents.size() - start) / kMinChunkBytes_);
+
+    if (num_chunks < 2) {
+        ExtractLines(contents, true, false);
+        return;
+    }
+
+    // chunks start at the first line starting after an even split, and
+    // chunks left empty by very long lines are dropped
+    std::vector<size_t> bounds(num_chunks + 1, contents.size());
+    bounds[0] = start;
+
+    for (size_t k = 1; k < num_chunks; k++) {
+        const size_t split = start
+            + (contents.size() - start) * k / num_chunks;
+        bounds[k] = std::max(bounds[k - 1],
+                std::min(contents.find('\n', split), contents.size() - 1)
+                + 1);
+    }
+
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+    num_chunks = bounds.size() - 1;
+
+    ExtractExchanges(contents.substr(0, start - 1));
+
+    // chunks are copies of the data, still empty but for its exchanges
+    std::vector<BtcData> chunks(num_chunks, *this);
+    ThreadPool pool(static_cast<int>(num_chunks));
+
+    for (size_t k = 0; k < num_chunks; k++) {
+        pool.Submit([&, k] {
+            chunks[k].parsed_bytes_ = bounds[k];
+            chunks[k].ExtractLines(contents.substr(0, bounds[k + 1]),
+                    k == num_chunks - 1, false);
+        });
+    }
+
+    pool.Wait();
+
+    size_t num_rows = 0;
+    for (const BtcData & chunk : chunks)
+        num_rows += chunk.tail_.columns.times.size();
+
+    Columns & rows = tail_.columns;
+    rows.times.reserve(num_rows);
+    rows.prices.reserve(num_rows);
+
+    for (const BtcData & chunk : chunks) {
+
+        const Columns & chunk_rows = chunk.tail_.columns;
+
+        rows.times.insert(rows.times.end(), chunk_rows.times.begin(),
+                chunk_rows.times.end());
+        rows.prices.insert(rows.prices.end(), chunk_rows.prices.begin(),
+                chunk_rows.prices.end());
+        rows.valid.Append(chunk_rows.valid);
+
+        for (size_t k = 0; k < exchanges_.size(); k++) {
+            rows.exchange_prices[k].insert(rows.exchange_prices[k].end(),
+                    chunk_rows.exchange_prices[k].begin(),
+                    chunk_rows.exchange_prices[k].end());
+            rows.exchange_valid[k].Append(chunk_rows.exchange_valid[k]);
+        }
+    }
+
+    parsed_bytes_ = chunks.back().parsed_bytes_;
+    has_partial_line_ = chunks.back().has_partial_line_;
+}
+
+/**
+ * Loads data from the binary cache file into the last block, until
+ * indexes are built.
+ *
+ * @param stamp Stamp of the current CSV file.
+ * @return True if the cache was valid and its data was loaded.
+ */
+bool BtcData::LoadCache(const PriceCache::Stamp & stamp) {
+
+    PriceCache cache(data_file_path_ + kCacheFileSuffix_, stamp);
+    if (!cache.IsValid())
+        return false;
+
+    exchanges_ = cache.ExchangeNames();
+    ClearTail();
+
+    Columns & rows = tail_.columns;
+    rows.times.reserve(cache.Size());
+    rows.prices.reserve(cache.Size());
+
+    Bitmap valid;
+
+    for (size_t r = 0; r < cache.NumRecords(); r++) {
+
+        const size_t size = cache.RecordSize(r);
+
+        rows.times.insert(rows.times.end(), cache.Times(r),
+                cache.Times(r) + size);
+        rows.prices.insert(rows.prices.end(), cache.Prices(r),
+                cache.Prices(r) + size);
+        valid.AssignWords(cache.Validity(r), size);
+        rows.valid.Append(valid);
+
+        for (size_t k = 0; k < exchanges_.size(); k++) {
+            rows.exchange_prices[k].insert(rows.exchange_prices[k].end(),
+                    cache.ExchangePrices(r, k),
+                    cache.ExchangePrices(r, k) + size);
+            valid.AssignWords(cache.ExchangeValidity(r, k), size);
+            rows.exchange_valid[k].Append(valid);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Saves data to the binary cache file, with one record per block. Failing
+ * to write it is not an error, the CSV file will just be parsed again next
+ * time.
+ *
+ * @param stamp Stamp of the CSV file the data was extracted from.
+ */
+void BtcData::SaveCache(const PriceCache::Stamp & stamp) {
+
+    std::vector<Columns> decoded;
+
+    PriceCache::Write(data_file_path_ + kCacheFileSuffix_, stamp, exchanges_,
+            kBlockRows_, GetRecords(0, decoded));
+}
+
+/**
+ * Appends the rows appended since a previous version of the data to the
+ * binary cache file, which takes rewriting the record of the block of the
+ * first new row and writing the records of the next blocks. If the cache
+ * file is not the one of the previous version, it is written again.
+ *
+ * @param prev_stamp Stamp of the CSV file the previous version was
+ * extracted from.
+ * @param prev_num_rows Number of rows of the previous version.
+ * @param stamp Stamp of the CSV file the data was extracted from.
+ */
+void BtcData::AppendCache(const PriceCache::Stamp & prev_stamp,
+        const size_t prev_num_rows, const PriceCache::Stamp & stamp) {
+
+    std::vector<Columns> decoded;
+
+    if (!PriceCache::Append(data_file_path_ + kCacheFileSuffix_, prev_stamp,
+                prev_num_rows, stamp, exchanges_.size(), kBlockRows_,
+                GetRecords(prev_num_rows / kBlockRows_, decoded)))
+        SaveCache(stamp);
+}
+
+/**
+ * Gets the records of the binary cache file of some blocks, as views of
+ * their columns, where compressed blocks are decoded.
+ *
+ * @param first_block Position of the first block, up to the number of
+ * sealed blocks.
+ * @param decoded Decoded columns of the compressed blocks, which must be
+ * kept while the records are used.
+ * @return Records of the blocks from the first one to the last one, but
+ * for an empty last block.
+ */
+std::vector<PriceCache::Record> BtcData::GetRecords(
+        const size_t first_block, std::vector<Columns> & decoded) const {
+
+    std::vector<PriceCache::Record> records;
+    decoded.assign(blocks_.size() + 1 - first_block, Columns());
+
+    for (size_t k = first_block; k <= blocks_.size(); k++) {
+
+        const Block & block = GetBlock(k);
+        const Columns & columns = block.columns;
+        const Columns * rows = &columns;
+
+        if (block.series.Size() > 0) {
+            Columns & storage = decoded[k - first_block];
+            block.series.DecodeBlock(0, storage.times, storage.prices,
+                    storage.valid);
+            rows = &storage;
+        }
+
+        if (rows->times.empty())
             continue;
 
-        float number;
-        if (std::stringstream(word) >> number)
-            prices.push_back(number);
+        PriceCache::Record record;
+        record.size = rows->times.size();
+        record.times = rows->times.data();
+        record.prices = rows->prices.data();
+        record.valid = rows->valid.Words();
+
+        for (size_t e = 0; e < exchanges_.size(); e++) {
+            record.exchange_prices.push_back(
+                    columns.exchange_prices[e].data());
+            record.exchange_valid.push_back(
+                    columns.exchange_valid[e].Words());
+        }
+
+        records.push_back(std::move(record));
     }
 
-    return ((prices.empty()) ? -1.0f : utils::GetAverage(prices));
+    return records;
+}
+
+/**
+ * Gets the bounds of the rows of the columns of a chart, as used by
+ * Resample(). The offset of every bound from the first time is rounded
+ * towards zero to whole time steps of the data, so for daily data and a
+ * first time at the start of a day, columns cover whole days, with column
+ * x covering days [day_a + (x - 1) * days / width, day_a + x * days /
+ * width).
+ *
+ * @param time_a First time, in seconds since 1970-01-01 00:00:00 UTC.
+ * @param time_b Second time, in seconds since 1970-01-01 00:00:00 UTC.
+ * @param width Number of columns.
+ * @param decoded Last block decoded by the query.
+ * @return Positions of the first row of the first column and of the end
+ * of every column, or no positions if there are no columns.
+ */
+std::vector<size_t> BtcData::ColumnBounds(const int64_t time_a,
+        const int64_t time_b, const int width, Decoded & decoded) const {
+
+    if (width <= 0)
+        return std::vector<size_t>();
+
+    const int64_t span = time_b - time_a;
+    const int64_t step = std::max(time_step_, int64_t(1));
+    std::vector<size_t> bounds(width + 1);
+
+    for (int x = -1; x < width; x++)
+        bounds[x + 1] = IndexOfTime(time_a + x * span / width / step * step,
+                decoded);
+
+    return bounds;
+}
+
+/**
+ * Aggregates prices of consecutive ranges of rows. Range x is
+ * [bounds[x], bounds[x + 1]), or empty if it starts before the end of a
+ * previous range.
+ *
+ * Ranges of few rows in a single block are computed in a single sweep
+ * over the rows, while ranges of many rows are combined from the aggregate
+ * pyramids of their blocks, touching only a few pyramid buckets per range,
+ * or from the summaries of compressed blocks.
+ *
+ * @param bounds Positions of the first row of the first range and of the
+ * end of every range.
+ * @param decoded Last block decoded by the query.
+ * @return Aggregated prices of each range.
+ */
+std::vector<BtcData::ColumnPrices> BtcData::AggregateRanges(
+        const std::vector<size_t> & bounds, Decoded & decoded) const {
+
+    std::vector<ColumnPrices> columns(
+            bounds.empty() ? 0 : bounds.size() - 1);
+    size_t i = bounds.empty() ? 0 : bounds[0];
+
+    for (size_t x = 0; x < columns.size(); x++) {
+
+        const size_t end = bounds[x + 1];
+        ColumnPrices & column = columns[x];
+        const size_t k = i / kBlockRows_;
+
+        if (end >= i + kMinPyramidRowsPerColumn_
+                || (end > i && (end - 1) / kBlockRows_ != k)) {
+
+            const auto bucket = AggregateRows(i, end, decoded);
+
+            if (bucket.count > 0) {
+                column.avg = float(bucket.sum / bucket.count);
+                column.min = bucket.low;
+                column.max = bucket.high;
+                column.first = bucket.open;
+                column.last = bucket.close;
+            }
+
+            i = end;
+            continue;
+        }
+
+        if (end > i) {
+            const Columns & rows = GetRows(GetBlock(k), decoded);
+            SweepRange(rows.prices.data(), rows.valid, i - k * kBlockRows_,
+                    end - k * kBlockRows_, column);
+        }
+
+        i = std::max(i, end);
+    }
+
+    return columns;
+}
+
+/**
+ * Aggregates the valid values of a range in a single sweep over them.
+ *
+ * @param values Values, or 0 where there is no data.
+ * @param valid Whether there is data for each value.
+ * @param a,b First and one past last positions of the range.
+ * @param column Aggregates of the range, left untouched if the range has
+ * no valid values.
+ */
+void BtcData::SweepRange(const float * values, const Bitmap & valid,
+        size_t a, const size_t b, ColumnPrices & column) {
+
+    double sum = 0.0;
+    int num_rows = 0;
+
+    for (; a < b; a++) {
+
+        if (!valid.Test(a))
+            continue;
+
+        const float value = values[a];
+
+        if (num_rows == 0) {
+            column.min = column.max = column.first = value;
+        } else {
+            column.min = std::min(column.min, value);
+            column.max = std::max(column.max, value);
+        }
+        column.last = value;
+
+        sum += value;
+        num_rows++;
+    }
+
+    if (num_rows > 0)
+        column.avg = float(sum / num_rows);
+}
+
+
+/**
+ * Extracts Bitcoin data at one time from one line of the data file.
+ *
+ * @param line View of one line of the data file.
+ * @param time_btc_data Extracted Bitcoin data, with a negative price if
+ * the line has no price data.
+ * @param exchange_prices Extracted prices of every exchange, negative for
+ * exchanges without data.
+ * @param num_exchanges Number of exchanges.
+ * @return True if the line starts with a valid time.
+ */
+bool BtcData::ExtractTimeBtcData(std::string_view line,
+        TimeBtcData & time_btc_data, float * exchange_prices,
+        const size_t num_exchanges) {
+
+    if (!line.empty() && line.back() == '\r')
+        line.remove_suffix(1);
+
+    // the time is the first field and the prices follow the first comma
+    const size_t comma = line.find(',');
+
+    if (!utils::ParseTime(line.substr(0, comma), time_btc_data.time))
+        return false;
+
+    // the price is the average of the prices of every exchange
+    time_btc_data.price = -1.0f;
+    utils::ParseAverage((comma == std::string_view::npos)
+            ? std::string_view() : line.substr(comma + 1), exchange_prices,
+            num_exchanges, time_btc_data.price);
+
+    return true;
 }
@@ -1,40 +1,231 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
+#include "aggregate_pyramid.h"
+#include "bitmap.h"
+#include "compressed_series.h"
+#include "price_cache.h"
 #include "utils.h"
 
 /**
  * Bitcoin data class.
+ *
+ * Holds a time series of Bitcoin prices keyed by epoch seconds, so it can
+ * hold daily, minute or tick data, and resamples it to chart columns or to
+ * buckets of any size on demand. Queries by day count days since genesis
+ * block. Besides the price averaged across exchanges, the price of every
+ * exchange is kept in a sparse column of its own, so charts can aggregate
+ * any subset of exchanges.
+ *
+ * Once loaded it is not modified, so it is shared between charts as an
+ * immutable snapshot, usually obtained with Get(). Changes in the CSV file
+ * are loaded into new snapshots with Reload(), which extends a copy of the
+ * current snapshot with Append() when rows have only been appended.
+ *
+ * Rows are stored in blocks of kBlockRows_ rows, each one with the indexes
+ * of its rows. Full blocks are sealed and never modified again, so copies
+ * of a snapshot share them and only copy the last block, which makes
+ * extending a copy cost the same whatever the number of rows.
+ *
+ * In compressed mode, chosen when loading, sealed blocks keep their times
+ * and averaged prices in a CompressedSeries instead of plain columns and
+ * an aggregate pyramid, which takes a fraction of their memory. Queries
+ * then combine the summaries of the blocks they cover whole, and decode
+ * the blocks at their ends. Prices of exchanges stay in plain columns.
  */
 class BtcData {
 public:
-    /// Bitcoin data from one day data structure.
-    struct DayBtcData {
-        int days_since_gen = 0;
-        struct utils::Date date;
-        float price = 0.0f;
+    /// Bitcoin data at one time data structure.
+    struct TimeBtcData {
+        int64_t time = 0; ///< Seconds since 1970-01-01 00:00:00 UTC.
+        float price = 0.0f; ///< Price, or negative if there is no data.
     };
 
+    /// Statistics of the prices of several exchanges at one time
+    /// enumeration.
+    enum ExchangeStat {
+        kMeanPrice, ///< Mean price.
+        kMedianPrice, ///< Median price.
+        kMinPrice, ///< Minimum price.
+        kMaxPrice, ///< Maximum price.
+        kSpreadPrice ///< Difference between maximum and minimum prices.
+    };
+
+    /// Bitcoin price statistics between two days data structure, where
+    /// every price is -1 if there is no data.
+    struct PriceStats {
+        int num_days = 0; ///< Number of rows with price data.
+        float avg = -1.0f; ///< Average price.
+        float stddev = -1.0f; ///< Standard deviation of prices.
+        float min = -1.0f, max = -1.0f; ///< Minimum and maximum prices.
+        float first = -1.0f, last = -1.0f; ///< First and last prices.
+    };
+
+    /// Bitcoin prices aggregated in one chart column or bucket data
+    /// structure, where every price is -1 if there is no data.
+    struct ColumnPrices {
+        float avg = -1.0f; ///< Average price.
+        float min = -1.0f, max = -1.0f; ///< Minimum and maximum prices.
+        float first = -1.0f, last = -1.0f; ///< First and last prices.
+    };
+
+    static const std::string kDefaultDataFilePath_;
+    static const int64_t kSecondsPerDay_;
+    static const size_t kBlockRows_;
+
     // constructor
-    BtcData();
+    explicit BtcData(
+            const std::string & data_file_path = kDefaultDataFilePath_,
+            const bool is_compressed = false);
+
+    static std::shared_ptr<const BtcData> Get(
+            const std::string & data_file_path = kDefaultDataFilePath_,
+            const bool is_compressed = false);
+    static void Publish(std::shared_ptr<const BtcData> btc_data);
+    static std::shared_ptr<const BtcData> Reload(
+            const std::shared_ptr<const BtcData> & btc_data);
 
     // public functions
-    float GetPrice(const int day_since_gen);
-    float GetAvgPrice(const int day_a, const int day_b);
-    float GetMaxPrice(const int day_a, const int day_b);
-    int GetLastDay();
+    bool Append(const TimeBtcData & time_btc_data,
+            const float * exchange_prices = nullptr);
+    size_t AppendCsv(std::string_view lines);
+
+    float GetPrice(const int day_since_gen) const;
+    float GetAvgPrice(const int day_a, const int day_b) const;
+    float GetMinPrice(const int day_a, const int day_b) const;
+    float GetMaxPrice(const int day_a, const int day_b) const;
+    int GetNumDays(const int day_a, const int day_b) const;
+    PriceStats GetStats(const int day_a, const int day_b) const;
+    AggregatePyramid::Bucket GetOhlc(const int day_a, const int day_b) const;
+    std::vector<ColumnPrices> Resample(const int64_t time_a,
+            const int64_t time_b, const int width) const;
+    std::vector<ColumnPrices> ResampleBuckets(const int64_t time_a,
+            const int64_t time_b, const int64_t bucket_size) const;
+    std::vector<ColumnPrices> ResampleExchanges(const int64_t time_a,
+            const int64_t time_b, const int width,
+            const std::vector<int> & exchange_ids,
+            const ExchangeStat exchange_stat) const;
+    const std::vector<std::string> & GetExchanges() const;
+    int GetExchangeId(const std::string & exchange) const;
+    CompressedSeries Compress() const;
+    int GetLastDay() const;
+    int64_t GetLastTime() const;
+    size_t GetNumRows() const;
+    size_t CountSharedBlocks(const BtcData & other) const;
+    size_t MemoryBytes() const;
+
+    size_t IndexOfDay(const int day) const;
+    size_t IndexOfTime(const int64_t time) const;
+
+    static int64_t TimeOfDay(const int day);
 
 private:
-    static const std::string kDataFilePath_;
-    static const int kInitialDaysSinceGen_;
+    static const std::string kCacheFileSuffix_;
+    static const utils::Date kGenesisDate_;
+    static const int kMaxTimeOffsetsPerRow_;
+    static const int kMinPyramidRowsPerColumn_;
+    static const size_t kMinChunkBytes_;
+
+    std::string data_file_path_; ///< Bitcoin data CSV file path.
+    /// Whether sealed blocks keep their times and prices compressed.
+    bool is_compressed_ = false;
+    PriceCache::Stamp stamp_; ///< Stamp of the CSV file when it was read.
+    /// Bytes of the CSV file extracted, up to the end of its last complete
+    /// line.
+    size_t parsed_bytes_ = 0;
+    /// Hash of the first and last bytes of the CSV file up to
+    /// parsed_bytes_, to tell whether they are unchanged on reload.
+    uint64_t parsed_hash_ = 0;
+    /// Whether a last line without line break was extracted.
+    bool has_partial_line_ = false;
+
+    /// Columns of consecutive rows of Bitcoin data data structure, one
+    /// position per row, sorted by time, with a single row per time.
+    struct Columns {
+        std::vector<int64_t> times; ///< Seconds since 1970-01-01.
+        std::vector<float> prices; ///< Prices, or 0 if there is no data.
+        Bitmap valid; ///< Whether there is price data for each row.
+        /// Prices of each exchange, or 0 if there is no data.
+        std::vector<std::vector<float>> exchange_prices;
+        /// Whether there is price data of each exchange for each row.
+        std::vector<Bitmap> exchange_valid;
+    };
+
+    /// Block of up to kBlockRows_ consecutive rows data structure, with the
+    /// indexes of its rows.
+    struct Block {
+        Columns columns; ///< Columns of the rows.
+        /// Greatest common divisor of the seconds between rows, or 0 if
+        /// there is less than two rows.
+        int64_t time_step = 0;
+        /// Position of each time step from the first time to the last
+        /// time, or empty if rows are binary-searched instead.
+        std::vector<uint32_t> time_offsets;
+        AggregatePyramid price_pyramid; ///< Aggregate pyramid of prices.
+        /// Times and prices of the rows in compressed mode, once sealed,
+        /// instead of their columns and aggregate pyramid.
+        CompressedSeries series;
+    };
+
+    /// Columns of a compressed block decoded by a query data structure,
+    /// kept while the query reads the rows of the same block.
+    struct Decoded {
+        const Block * block = nullptr; ///< Decoded block, or null if none.
+        Columns columns; ///< Times, prices and validity of its rows.
+    };
+
+    std::vector<std::string> exchanges_; ///< Names of the exchanges.
+    /// Full blocks of the first rows, which are never modified, so they
+    /// are shared by every copy of the data.
+    std::vector<std::shared_ptr<const Block>> blocks_;
+    /// Block of the last rows, not full yet, without time offsets.
+    Block tail_;
 
-    /// Vector of all days Bitcoin data.
-    std::vector<DayBtcData> btc_data_;
+    /// Greatest common divisor of the seconds between rows, or 0 if there
+    /// is less than two rows.
+    int64_t time_step_ = 0;
 
     // helper functions
-    DayBtcData ExtractDayBtcData(const std::string & line);
-    static utils::Date ExtractDate(const std::string & date_str);
-    static float ExtractAveragePrice(const std::string & prices_str);
-    float FindMaxPrice();
+    void BuildIndexes();
+    void SealTail();
+    void ClearTail();
+    const Block & GetBlock(const size_t k) const;
+    static const Columns & GetRows(const Block & block, Decoded & decoded);
+    static int64_t GetFirstTime(const Block & block);
+    static int64_t GetLastTime(const Block & block);
+    size_t IndexOfTime(const int64_t time, Decoded & decoded) const;
+    template <typename Function>
+    void ForEachBlock(const size_t a, const size_t b,
+            Function function) const;
+    AggregatePyramid::Bucket AggregateRows(const size_t a, const size_t b,
+            Decoded & decoded) const;
+    AggregatePyramid::Bucket AggregateDays(const int day_a, const int day_b)
+        const;
+    void SortRows();
+    void PushRow(const TimeBtcData & time_btc_data,
+            const float * exchange_prices);
+    void ExtractExchanges(std::string_view titles_line);
+    bool IsExtractedPrefix(std::string_view contents) const;
+    bool ExtractLines(std::string_view contents,
+            const bool extract_partial_line, const bool append);
+    void ExtractChunks(std::string_view contents);
+    bool LoadCache(const PriceCache::Stamp & stamp);
+    void SaveCache(const PriceCache::Stamp & stamp);
+    void AppendCache(const PriceCache::Stamp & prev_stamp,
+            const size_t prev_num_rows, const PriceCache::Stamp & stamp);
+    std::vector<PriceCache::Record> GetRecords(const size_t first_block,
+            std::vector<Columns> & decoded) const;
+    std::vector<size_t> ColumnBounds(const int64_t time_a,
+            const int64_t time_b, const int width, Decoded & decoded) const;
+    std::vector<ColumnPrices> AggregateRanges(
+            const std::vector<size_t> & bounds, Decoded & decoded) const;
+    static void SweepRange(const float * values, const Bitmap & valid,
+            size_t a, const size_t b, ColumnPrices & column);
+    static bool ExtractTimeBtcData(std::string_view line,
+            TimeBtcData & time_btc_data, float * exchange_prices,
+            const size_t num_exchanges);
 };
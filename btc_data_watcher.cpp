@@ -0,0 +1,162 @@
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include "btc_data_watcher.h"
+
+
+/// Interval between checks of the file when inotify or the stop pipe are
+/// not available.
+const int BtcDataWatcher::kPollIntervalMs_ = 1000;
+
+/**
+ * Constructor.
+ * Gets the current snapshot and starts watching the file.
+ *
+ * @param data_file_path Bitcoin data CSV file path.
+ */
+BtcDataWatcher::BtcDataWatcher(const std::string & data_file_path)
+    : data_file_path_(data_file_path),
+        snapshot_(BtcData::Get(data_file_path)) {
+
+    if (pipe(stop_fds_) != 0)
+        stop_fds_[0] = stop_fds_[1] = -1;
+
+    thread_ = std::thread(&BtcDataWatcher::WatchLoop, this);
+}
+
+/**
+ * Destructor.
+ * Stops watching the file.
+ */
+BtcDataWatcher::~BtcDataWatcher() {
+
+    is_stopping_ = true;
+
+    // wakes up the watching thread, which otherwise notices it on its next
+    // periodic check
+    const char byte = 0;
+    if (stop_fds_[1] >= 0)
+        while (write(stop_fds_[1], &byte, 1) < 0 && errno == EINTR) {}
+
+    thread_.join();
+
+    for (const int fd : stop_fds_)
+        if (fd >= 0)
+            close(fd);
+}
+
+/**
+ * Gets the current snapshot, without locking.
+ *
+ * @return Current Bitcoin data snapshot.
+ */
+std::shared_ptr<const BtcData> BtcDataWatcher::GetSnapshot() const {
+
+    return std::atomic_load(&snapshot_);
+}
+
+/**
+ * Waits until a snapshot other than the given one is published.
+ *
+ * @param btc_data Snapshot already seen.
+ * @return Newer Bitcoin data snapshot.
+ */
+std::shared_ptr<const BtcData> BtcDataWatcher::WaitForUpdate(
+        const std::shared_ptr<const BtcData> & btc_data) {
+
+    std::unique_lock<std::mutex> lock(update_mutex_);
+    update_cv_.wait(lock, [&] { return GetSnapshot() != btc_data; });
+
+    return GetSnapshot();
+}
+
+/**
+ * Waits for changes in the file and reloads it, until stopped. The
+ * directory is watched rather than the file, so files replaced by a
+ * rename are also noticed.
+ */
+void BtcDataWatcher::WatchLoop() {
+
+    int inotify_fd = -1;
+    std::string file_name = data_file_path_;
+
+#ifdef __linux__
+    const size_t slash = data_file_path_.find_last_of('/');
+    const std::string dir = (slash == std::string::npos) ? "."
+        : data_file_path_.substr(0, slash + 1);
+    if (slash != std::string::npos)
+        file_name = data_file_path_.substr(slash + 1);
+
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd >= 0 && inotify_add_watch(inotify_fd, dir.c_str(),
+                IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+#endif
+
+    while (!is_stopping_) {
+
+        pollfd fds[2] = {{stop_fds_[0], POLLIN, 0}, {inotify_fd, POLLIN, 0}};
+        const int num_fds = (inotify_fd >= 0) ? 2 : 1;
+        const int timeout = (inotify_fd >= 0 && stop_fds_[0] >= 0) ? -1
+            : kPollIntervalMs_;
+
+        if (poll(fds, num_fds, timeout) < 0 || is_stopping_)
+            continue;
+
+        if (inotify_fd < 0) {
+            ReloadSnapshot();
+            continue;
+        }
+
+#ifdef __linux__
+        if (!(fds[1].revents & POLLIN))
+            continue;
+
+        // reloads once for all pending events on the watched file
+        bool is_changed = false;
+        alignas(inotify_event) char buffer[4096];
+        ssize_t n;
+
+        while ((n = read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+            for (ssize_t i = 0; i < n; ) {
+                const auto * event = reinterpret_cast<const inotify_event *>(
+                        buffer + i);
+                if (event->len > 0 && file_name == event->name)
+                    is_changed = true;
+                i += sizeof(inotify_event) + event->len;
+            }
+        }
+
+        if (is_changed)
+            ReloadSnapshot();
+#endif
+    }
+
+    if (inotify_fd >= 0)
+        close(inotify_fd);
+}
+
+/**
+ * Reloads the file and publishes the new snapshot, if it changed.
+ */
+void BtcDataWatcher::ReloadSnapshot() {
+
+    const auto btc_data = GetSnapshot();
+    const auto next = BtcData::Reload(btc_data);
+
+    if (next == btc_data)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(update_mutex_);
+        std::atomic_store(&snapshot_, next);
+    }
+    BtcData::Publish(next);
+
+    update_cv_.notify_all();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "btc_data.h"
+
+
+/**
+ * Bitcoin data watcher class.
+ *
+ * Watches a Bitcoin data CSV file from a background thread, with inotify
+ * on Linux, and reloads it whenever it changes. Each reload is published
+ * as a new BtcData snapshot by an atomic pointer swap, both here and in
+ * the BtcData registry, while renders holding the previous snapshot keep
+ * using it until they finish.
+ */
+class BtcDataWatcher {
+public:
+    // constructor and destructor
+    explicit BtcDataWatcher(const std::string & data_file_path
+            = BtcData::kDefaultDataFilePath_);
+    ~BtcDataWatcher();
+
+    BtcDataWatcher(const BtcDataWatcher &) = delete;
+    BtcDataWatcher & operator=(const BtcDataWatcher &) = delete;
+
+    // public functions
+    std::shared_ptr<const BtcData> GetSnapshot() const;
+    std::shared_ptr<const BtcData> WaitForUpdate(
+            const std::shared_ptr<const BtcData> & btc_data);
+
+private:
+    static const int kPollIntervalMs_;
+
+    std::string data_file_path_; ///< Watched CSV file path.
+    std::shared_ptr<const BtcData> snapshot_; ///< Current data snapshot.
+
+    std::thread thread_; ///< Watching thread.
+    int stop_fds_[2] = {-1, -1}; ///< Pipe to wake up the watching thread.
+    std::atomic<bool> is_stopping_{false}; ///< Whether to stop watching.
+
+    std::mutex update_mutex_; ///< Mutex for waiting for updates.
+    std::condition_variable update_cv_; ///< Signals new snapshots.
+
+    // helper functions
+    void WatchLoop();
+    void ReloadSnapshot();
+};
@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include "thread_pool.h"
+#include "chart_batch.h"
+
+
+/**
+ * Reads charts to generate from a manifest file.
+ *
+ * @param path Manifest file path.
+ * @return True if the file could be read, even if some lines were not
+ * valid and were skipped.
+ */
+bool ChartBatch::ReadManifest(const std::string & path) {
+
+    std::ifstream file(path);
+
+    if (!file.is_open()) {
+        std::cerr << "Error: could not open " << path << '\n';
+        return false;
+    }
+
+    std::string line;
+
+    for (int i = 1; getline(file, line); i++) {
+
+        const size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#')
+            continue;
+
+        if (!ParseJob(line, jobs_))
+            std::cerr << "Error: invalid line " << i << " in " << path
+                << '\n';
+    }
+
+    return true;
+}
+
+/**
+ * Generates all charts, each one as a task of a pool of worker threads.
+ * If any chart draws a series, the Dataset of the default block time and
+ * CoinMarketCap files is loaded first, and shared by all charts.
+ *
+ * @param btc_data Bitcoin data snapshot shared by all charts.
+ * @param num_threads Number of worker threads.
+ */
+void ChartBatch::Run(const std::shared_ptr<const BtcData> & btc_data,
+        const int num_threads) {
+
+    // the dataset is only loaded if a chart draws one of its series
+    std::shared_ptr<const Dataset> dataset;
+    if (std::any_of(jobs_.begin(), jobs_.end(),
+                [](const Job & job) { return !job.cfg.series.empty(); }))
+        dataset = std::make_shared<const Dataset>(std::vector<Dataset::Source>{
+                Dataset::BitcoinityTimeBetweenBlocks(),
+                Dataset::CoinBitcoin()}, num_threads);
+
+    ThreadPool pool(num_threads);
+
+    for (auto & job : jobs_) {
+        pool.Submit([btc_data, dataset, &job] {
+            BtcChart btc_chart(btc_data, dataset);
+            btc_chart.Generate(job.path, job.cfg);
+        });
+    }
+
+    pool.Wait();
+}
+
+/**
+ * Gets number of charts to generate.
+ *
+ * @return Number of charts.
+ */
+size_t ChartBatch::NumJobs() const {
+
+    return jobs_.size();
+}
+
+/**
+ * Parses one manifest line into a chart job.
+ *
+ * @param line Manifest line.
+ * @param jobs Jobs to append the parsed job to.
+ * @return True if the line was valid.
+ */
+bool ChartBatch::ParseJob(const std::string & line, std::vector<Job> & jobs) {
+
+    std::istringstream line_ss(line);
+
+    std::string path, time_a_str, time_b_str, scale_str;
+    std::string price_mode_str = "avg";
+    std::string exchanges_str, exchange_stat_str = "mean", series;
+    int width, height;
+    int64_t time_a, time_b;
+    float bottom_price, top_price;
+
+    if (!(line_ss >> path >> width >> height >> time_a_str >> time_b_str
+                >> bottom_price >> top_price >> scale_str))
+        return false;
+    line_ss >> price_mode_str >> exchanges_str >> exchange_stat_str
+        >> series;
+
+    // rejects lines with tokens after the last field
+    std::string extra;
+    if (line_ss >> extra)
+        return false;
+
+    if (width <= 0 || height <= 0
+            || !utils::ParseTime(time_a_str, time_a)
+            || !utils::ParseTime(time_b_str, time_b))
+        return false;
+
+    utils::Scale scale;
+    if (scale_str == "linear")
+        scale = utils::kLinear;
+    else if (scale_str == "log")
+        scale = utils::kLogarithmic;
+    else
+        return false;
+
+    BtcChart::PriceMode price_mode;
+    if (price_mode_str == "avg")
+        price_mode = BtcChart::kAvgPrice;
+    else if (price_mode_str == "envelope")
+        price_mode = BtcChart::kEnvelopePrice;
+    else
+        return false;
+
+    BtcData::ExchangeStat exchange_stat;
+    if (exchange_stat_str == "mean")
+        exchange_stat = BtcData::kMeanPrice;
+    else if (exchange_stat_str == "median")
+        exchange_stat = BtcData::kMedianPrice;
+    else if (exchange_stat_str == "min")
+        exchange_stat = BtcData::kMinPrice;
+    else if (exchange_stat_str == "max")
+        exchange_stat = BtcData::kMaxPrice;
+    else if (exchange_stat_str == "spread")
+        exchange_stat = BtcData::kSpreadPrice;
+    else
+        return false;
+
+    jobs.push_back({path, BtcChart::Cfg(width, height, time_a, time_b,
+                bottom_price, top_price, scale, price_mode)});
+
+    std::istringstream exchanges_ss(exchanges_str);
+    for (std::string exchange; std::getline(exchanges_ss, exchange, ','); )
+        if (!exchange.empty() && exchange != "-")
+            jobs.back().cfg.exchanges.push_back(exchange);
+    jobs.back().cfg.exchange_stat = exchange_stat;
+    jobs.back().cfg.series = series;
+
+    return true;
+}
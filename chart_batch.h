@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "btc_chart.h"
+#include "btc_data.h"
+
+
+/**
+ * Batch of Bitcoin charts, generated from a manifest file.
+ *
+ * Every line of the manifest describes one chart as:
+ * path width height time_a time_b bottom_price top_price scale [price_mode
+ * [exchanges [exchange_stat [series]]]]
+ * where times are 'YYYY-MM-DD', 'YYYY-MM-DDTHH:MM[:SS]' (UTC) or epoch
+ * seconds, scale is 'linear' or 'log' and price_mode is 'avg' (default) or
+ * 'envelope'. Exchanges are a comma-separated list of exchange names or
+ * 'all', whose prices are combined with exchange_stat, which is 'mean'
+ * (default), 'median', 'min', 'max' or 'spread'. Without exchanges, or
+ * with '-', the price averaged across exchanges is drawn. Series is a
+ * column of the default Dataset sources, such as 'volume' or 'block_time',
+ * drawn instead of the price, with bottom_price and top_price as its
+ * bottom and top values. Empty lines and lines starting with '#' are
+ * ignored.
+ *
+ * All charts share the same BtcData snapshot, and the same Dataset if any
+ * chart draws a series, and are drawn and encoded on a pool of worker
+ * threads.
+ */
+class ChartBatch {
+public:
+    /// Chart job data structure.
+    struct Job {
+        std::string path; ///< Path where to save the chart image.
+        BtcChart::Cfg cfg; ///< Chart config.
+    };
+
+    // public functions
+    bool ReadManifest(const std::string & path);
+    void Run(const std::shared_ptr<const BtcData> & btc_data,
+            const int num_threads);
+    size_t NumJobs() const;
+
+private:
+    std::vector<Job> jobs_; ///< Charts to generate.
+
+    // helper functions
+    static bool ParseJob(const std::string & line, std::vector<Job> & jobs);
+};
@@ -0,0 +1,418 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "compressed_series.h"
+
+
+/// Maximum number of points per block.
+const size_t CompressedSeries::kBlockSize_ = 4096;
+
+/// Bits stored as the value of points without data, a quiet NaN.
+const uint32_t CompressedSeries::kNoDataBits_ = 0x7FC00000;
+
+namespace {
+
+/// Reader of a bit stream, from a bit position data structure.
+struct BitReader {
+    const uint64_t * words; ///< Bit stream, 64 bits per word.
+    size_t pos; ///< Position of the next bit.
+
+    /**
+     * Reads some bits, written by CompressedSeries::WriteBits().
+     *
+     * @param num_bits Number of bits, up to 64.
+     * @return Bits read, in the lowest bits.
+     */
+    uint64_t Read(const int num_bits) {
+
+        if (num_bits == 0)
+            return 0;
+
+        const size_t shift = pos % 64;
+        uint64_t bits = words[pos / 64] >> shift;
+
+        if (shift + num_bits > 64)
+            bits |= words[pos / 64 + 1] << (64 - shift);
+        if (num_bits < 64)
+            bits &= (uint64_t(1) << num_bits) - 1;
+
+        pos += num_bits;
+
+        return bits;
+    }
+
+    /**
+     * Reads a signed number of some bits, in two's complement.
+     *
+     * @param num_bits Number of bits, less than 64.
+     * @return Number read.
+     */
+    int64_t ReadSigned(const int num_bits) {
+
+        return int64_t(Read(num_bits) << (64 - num_bits)) >> (64 - num_bits);
+    }
+};
+
+/**
+ * Makes the aggregates of a single value.
+ *
+ * @param value Value.
+ * @return Aggregates of the value.
+ */
+AggregatePyramid::Bucket PointBucket(const float value) {
+
+    AggregatePyramid::Bucket bucket;
+    bucket.open = bucket.high = bucket.low = bucket.close = value;
+    bucket.sum = value;
+    bucket.count = 1;
+
+    return bucket;
+}
+
+}
+
+/**
+ * Appends one point after the last point, encoding it into the last block
+ * or into a new block if the last one is full. Points at the last time or
+ * earlier are rejected, since points are sorted by time.
+ *
+ * @param time Time, in seconds since 1970-01-01 00:00:00 UTC.
+ * @param value Value, ignored if there is no data.
+ * @param is_valid Whether the point has data.
+ * @return True if the point was appended, false if its time is not after
+ * the last time.
+ */
+bool CompressedSeries::Append(const int64_t time, const float value,
+        const bool is_valid) {
+
+    if (!blocks_.empty() && time <= blocks_.back().last_time)
+        return false;
+
+    const bool has_data = is_valid && !std::isnan(value);
+    uint32_t bits = kNoDataBits_;
+    if (has_data)
+        memcpy(&bits, &value, sizeof(bits));
+
+    if (blocks_.empty() || blocks_.back().size == kBlockSize_) {
+
+        // first point of a block, stored in full
+        Block block;
+        block.bit_pos = num_bits_;
+        block.first_time = time;
+        blocks_.push_back(block);
+
+        WriteBits(uint64_t(time), 64);
+        WriteBits(bits, 32);
+
+        prev_delta_ = 0;
+        prev_leading_ = 32; // no XOR window yet
+        prev_trailing_ = 0;
+
+    } else {
+        EncodeTime(time);
+        EncodeValue(bits);
+    }
+
+    prev_bits_ = bits;
+
+    Block & block = blocks_.back();
+    block.last_time = time;
+    block.size++;
+    if (has_data)
+        AggregatePyramid::Combine(block.summary, PointBucket(value));
+
+    return true;
+}
+
+/**
+ * Gets number of points.
+ *
+ * @return Number of points.
+ */
+size_t CompressedSeries::Size() const {
+
+    return blocks_.empty() ? 0
+        : (blocks_.size() - 1) * kBlockSize_ + blocks_.back().size;
+}
+
+/**
+ * Gets number of blocks.
+ *
+ * @return Number of blocks.
+ */
+size_t CompressedSeries::NumBlocks() const {
+
+    return blocks_.size();
+}
+
+/**
+ * Gets bytes of memory used by the encoded points and their blocks.
+ *
+ * @return Bytes of memory.
+ */
+size_t CompressedSeries::MemoryBytes() const {
+
+    return words_.size() * sizeof(uint64_t) + blocks_.size() * sizeof(Block);
+}
+
+/**
+ * Gets time of the first point.
+ *
+ * @return Time, in seconds since 1970-01-01 00:00:00 UTC.
+ */
+int64_t CompressedSeries::GetFirstTime() const {
+
+    return blocks_.front().first_time;
+}
+
+/**
+ * Gets time of the last point.
+ *
+ * @return Time, in seconds since 1970-01-01 00:00:00 UTC.
+ */
+int64_t CompressedSeries::GetLastTime() const {
+
+    return blocks_.back().last_time;
+}
+
+/**
+ * Decodes the points of a block.
+ *
+ * @param k Block position, less than NumBlocks().
+ * @param times Decoded times of the points.
+ * @param values Decoded values of the points, or 0 if there is no data.
+ * @param valid Whether each point has data.
+ */
+void CompressedSeries::DecodeBlock(const size_t k,
+        std::vector<int64_t> & times, std::vector<float> & values,
+        Bitmap & valid) const {
+
+    const Block & block = blocks_[k];
+    BitReader reader = {words_.data(), block.bit_pos};
+
+    times.resize(block.size);
+    values.resize(block.size);
+    valid.Assign(block.size, false);
+
+    int64_t time = int64_t(reader.Read(64));
+    int64_t delta = 0;
+    uint32_t bits = uint32_t(reader.Read(32));
+    int leading = 32, trailing = 0;
+
+    for (size_t i = 0; i < block.size; i++) {
+
+        if (i > 0) {
+
+            // delta of delta of times, with its size in a unary prefix
+            if (reader.Read(1)) {
+                if (!reader.Read(1))
+                    delta += reader.ReadSigned(7);
+                else if (!reader.Read(1))
+                    delta += reader.ReadSigned(9);
+                else if (!reader.Read(1))
+                    delta += reader.ReadSigned(12);
+                else
+                    delta += int64_t(reader.Read(64));
+            }
+
+            time += delta;
+
+            // XOR with the previous value, within the previous window of
+            // meaningful bits or a new one
+            if (reader.Read(1)) {
+                if (reader.Read(1)) {
+                    leading = int(reader.Read(5));
+                    trailing = 32 - leading - (int(reader.Read(5)) + 1);
+                }
+                bits ^= uint32_t(reader.Read(32 - leading - trailing))
+                    << trailing;
+            }
+        }
+
+        times[i] = time;
+
+        if (bits != kNoDataBits_) {
+            memcpy(&values[i], &bits, sizeof(bits));
+            valid.Set(i, true);
+        } else {
+            values[i] = 0.0f;
+        }
+    }
+}
+
+/**
+ * Aggregates the values of the points between two times.
+ *
+ * @param time_a First time, in seconds since 1970-01-01 00:00:00 UTC.
+ * @param time_b Second time, in seconds since 1970-01-01 00:00:00 UTC.
+ * @return Aggregates of the values of the points in [time_a, time_b).
+ */
+AggregatePyramid::Bucket CompressedSeries::Query(const int64_t time_a,
+        const int64_t time_b) const {
+
+    return QueryRanges({time_a, time_b})[0];
+}
+
+/**
+ * Aggregates the values of the points of consecutive ranges of times.
+ * Blocks inside a range are combined from their summaries, while blocks
+ * at the ends of ranges are decoded, each one only once while ranges
+ * are sorted.
+ *
+ * @param bounds Times of the start of the first range and of the end of
+ * every range, where range x is [bounds[x], bounds[x + 1]).
+ * @return Aggregates of the values of each range.
+ */
+std::vector<AggregatePyramid::Bucket> CompressedSeries::QueryRanges(
+        const std::vector<int64_t> & bounds) const {
+
+    std::vector<AggregatePyramid::Bucket> buckets(
+            bounds.empty() ? 0 : bounds.size() - 1);
+
+    // last decoded block
+    size_t decoded = blocks_.size();
+    std::vector<int64_t> times;
+    std::vector<float> values;
+    Bitmap valid;
+
+    for (size_t x = 0; x < buckets.size(); x++) {
+
+        const int64_t time_a = bounds[x], time_b = bounds[x + 1];
+
+        for (size_t k = FindBlock(time_a);
+                k < blocks_.size() && blocks_[k].first_time < time_b; k++) {
+
+            const Block & block = blocks_[k];
+
+            if (block.first_time >= time_a && block.last_time < time_b) {
+                AggregatePyramid::Combine(buckets[x], block.summary);
+                continue;
+            }
+
+            if (decoded != k) {
+                DecodeBlock(k, times, values, valid);
+                decoded = k;
+            }
+
+            const size_t a = size_t(std::lower_bound(times.begin(),
+                        times.end(), time_a) - times.begin());
+            const size_t b = size_t(std::lower_bound(times.begin(),
+                        times.end(), time_b) - times.begin());
+
+            for (size_t i = a; i < b; i++)
+                if (valid.Test(i))
+                    AggregatePyramid::Combine(buckets[x],
+                            PointBucket(values[i]));
+        }
+    }
+
+    return buckets;
+}
+
+/**
+ * Appends some bits to the bit stream.
+ *
+ * @param bits Bits to append, in the lowest bits.
+ * @param num_bits Number of bits, up to 64.
+ */
+void CompressedSeries::WriteBits(uint64_t bits, const int num_bits) {
+
+    if (num_bits == 0)
+        return;
+    if (num_bits < 64)
+        bits &= (uint64_t(1) << num_bits) - 1;
+
+    const size_t shift = num_bits_ % 64;
+
+    if (shift == 0)
+        words_.push_back(0);
+    words_.back() |= bits << shift;
+    if (shift + num_bits > 64)
+        words_.push_back(bits >> (64 - shift));
+
+    num_bits_ += num_bits;
+}
+
+/**
+ * Encodes the time of a point as the difference between its delta from
+ * the last time and the last delta, which is 0 for regular times. Small
+ * differences are stored in 7, 9 or 12 bits, after a unary prefix.
+ *
+ * @param time Time, after the last time.
+ */
+void CompressedSeries::EncodeTime(const int64_t time) {
+
+    const int64_t delta = time - blocks_.back().last_time;
+    const int64_t dod = delta - prev_delta_;
+
+    if (dod == 0) {
+        WriteBits(0, 1);
+    } else if (dod >= -64 && dod < 64) {
+        WriteBits(0x1, 2);
+        WriteBits(uint64_t(dod), 7);
+    } else if (dod >= -256 && dod < 256) {
+        WriteBits(0x3, 3);
+        WriteBits(uint64_t(dod), 9);
+    } else if (dod >= -2048 && dod < 2048) {
+        WriteBits(0x7, 4);
+        WriteBits(uint64_t(dod), 12);
+    } else {
+        WriteBits(0xF, 4);
+        WriteBits(uint64_t(dod), 64);
+    }
+
+    prev_delta_ = delta;
+}
+
+/**
+ * Encodes the bits of the value of a point XORed with the last value. An
+ * unchanged value takes one bit, and otherwise only the meaningful bits of
+ * the XOR are stored, within the last window of meaningful bits if they
+ * fit in it.
+ *
+ * @param bits Bits of the value.
+ */
+void CompressedSeries::EncodeValue(const uint32_t bits) {
+
+    const uint32_t xor_bits = bits ^ prev_bits_;
+
+    if (xor_bits == 0) {
+        WriteBits(0, 1);
+        return;
+    }
+
+    const int leading = __builtin_clz(xor_bits);
+    const int trailing = __builtin_ctz(xor_bits);
+
+    if (leading >= prev_leading_ && trailing >= prev_trailing_) {
+        WriteBits(0x1, 2);
+        WriteBits(xor_bits >> prev_trailing_,
+                32 - prev_leading_ - prev_trailing_);
+        return;
+    }
+
+    const int num_meaningful_bits = 32 - leading - trailing;
+
+    WriteBits(0x3, 2);
+    WriteBits(uint64_t(leading), 5);
+    WriteBits(uint64_t(num_meaningful_bits - 1), 5);
+    WriteBits(xor_bits >> trailing, num_meaningful_bits);
+
+    prev_leading_ = leading;
+    prev_trailing_ = trailing;
+}
+
+/**
+ * Finds the first block ending at a time or later.
+ *
+ * @param time Time, in seconds since 1970-01-01 00:00:00 UTC.
+ * @return Position of the block, or the number of blocks if there is
+ * none.
+ */
+size_t CompressedSeries::FindBlock(const int64_t time) const {
+
+    return size_t(std::lower_bound(blocks_.begin(), blocks_.end(), time,
+                [](const Block & block, const int64_t t) {
+                    return block.last_time < t;
+                }) - blocks_.begin());
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "aggregate_pyramid.h"
+
+
+/**
+ * Compressed time series of values, for long tick or minute histories.
+ * BtcData keeps the times and prices of its sealed blocks in one series
+ * per block in compressed mode, and encodes copies of them with
+ * BtcData::Compress().
+ *
+ * Points are encoded into a single bit stream in blocks of up to
+ * kBlockSize_ points, with delta-of-delta times and values XORed with the
+ * previous value, so regular times and repeated or close values take only
+ * a few bits each. Every block is decoded on its own and has a summary of
+ * its values, so range queries combine the summaries of the blocks inside
+ * the range and only decode the blocks at its ends.
+ */
+class CompressedSeries {
+public:
+    static const size_t kBlockSize_;
+
+    // public functions
+    bool Append(const int64_t time, const float value, const bool is_valid);
+    size_t Size() const;
+    size_t NumBlocks() const;
+    size_t MemoryBytes() const;
+    int64_t GetFirstTime() const;
+    int64_t GetLastTime() const;
+
+    void DecodeBlock(const size_t k, std::vector<int64_t> & times,
+            std::vector<float> & values, Bitmap & valid) const;
+    AggregatePyramid::Bucket Query(const int64_t time_a,
+            const int64_t time_b) const;
+    std::vector<AggregatePyramid::Bucket> QueryRanges(
+            const std::vector<int64_t> & bounds) const;
+
+private:
+    static const uint32_t kNoDataBits_;
+
+    /// Block of consecutive points data structure.
+    struct Block {
+        size_t bit_pos = 0; ///< Position of its first bit in the stream.
+        uint32_t size = 0; ///< Number of points.
+        int64_t first_time = 0, last_time = 0; ///< Times of its ends.
+        AggregatePyramid::Bucket summary; ///< Aggregates of its values.
+    };
+
+    std::vector<Block> blocks_; ///< Blocks, sorted by time.
+    std::vector<uint64_t> words_; ///< Bit stream, 64 bits per word.
+    size_t num_bits_ = 0; ///< Number of bits in the stream.
+
+    // encoder state of the last block
+    int64_t prev_delta_ = 0; ///< Seconds between the last two points.
+    uint32_t prev_bits_ = 0; ///< Bits of the last value.
+    int prev_leading_ = 0; ///< Leading zero bits of the last XOR.
+    int prev_trailing_ = 0; ///< Trailing zero bits of the last XOR.
+
+    // helper functions
+    void WriteBits(uint64_t bits, const int num_bits);
+    void EncodeTime(const int64_t time);
+    void EncodeValue(const uint32_t bits);
+    size_t FindBlock(const int64_t time) const;
+};
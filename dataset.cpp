@@ -0,0 +1,484 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include "btc_data.h"
+#include "mapped_file.h"
+#include "range_kernels.h"
+#include "utils.h"
+#include "dataset.h"
+
+
+/**
+ * Gets the source of the Bitcoinity price file, with one 'price' column
+ * averaging the prices of every exchange.
+ *
+ * @param path CSV file path.
+ * @return Source data structure.
+ */
+Dataset::Source Dataset::BitcoinityPrice(const std::string & path) {
+
+    return {path, 0, {{"price", 1, -1}}};
+}
+
+/**
+ * Gets the source of the Bitcoinity time between blocks file, with one
+ * 'block_time' column.
+ *
+ * @param path CSV file path.
+ * @return Source data structure.
+ */
+Dataset::Source Dataset::BitcoinityTimeBetweenBlocks(
+        const std::string & path) {
+
+    return {path, 0, {{"block_time", 1, 1}}};
+}
+
+/**
+ * Gets the source of the CoinMarketCap Bitcoin file, with 'high', 'low',
+ * 'open', 'close', 'volume' and 'marketcap' columns.
+ *
+ * @param path CSV file path.
+ * @return Source data structure.
+ */
+Dataset::Source Dataset::CoinBitcoin(const std::string & path) {
+
+    return {path, 3, {{"high", 4, 4}, {"low", 5, 5}, {"open", 6, 6},
+        {"close", 7, 7}, {"volume", 8, 8}, {"marketcap", 9, 9}}};
+}
+
+/**
+ * Constructor.
+ * Extracts every source as a task of a pool of worker threads, aligns
+ * their columns on the timeline of all their days and builds the range
+ * aggregation index of every column, also in parallel. Sources that can
+ * not be read and columns with repeated names are left out.
+ *
+ * @param sources CSV sources.
+ * @param num_threads Number of worker threads.
+ */
+Dataset::Dataset(const std::vector<Source> & sources,
+        const int num_threads) {
+
+    std::vector<Table> tables(sources.size());
+    std::vector<char> is_extracted(sources.size(), false);
+
+    ThreadPool pool(num_threads);
+
+    for (size_t s = 0; s < sources.size(); s++) {
+        pool.Submit([&, s] {
+            is_extracted[s] = ExtractTable(sources[s], tables[s]);
+        });
+    }
+
+    pool.Wait();
+
+    // timeline from the first to the last day of any source
+    int first_day = std::numeric_limits<int>::max();
+    int last_day = std::numeric_limits<int>::min();
+
+    for (size_t s = 0; s < sources.size(); s++) {
+        if (!is_extracted[s] || tables[s].days.empty())
+            continue;
+        const auto minmax = std::minmax_element(tables[s].days.begin(),
+                tables[s].days.end());
+        first_day = std::min(first_day, *minmax.first);
+        last_day = std::max(last_day, *minmax.second);
+    }
+
+    if (first_day > last_day)
+        return;
+
+    first_day_ = first_day;
+    num_days_ = size_t(last_day - first_day + 1);
+
+    for (size_t s = 0; s < sources.size(); s++) {
+
+        if (!is_extracted[s])
+            continue;
+
+        const Table & table = tables[s];
+
+        for (size_t c = 0; c < sources[s].columns.size(); c++) {
+
+            const std::string & name = sources[s].columns[c].name;
+
+            if (columns_.count(name) != 0) {
+                std::cerr << "Error: repeated column " << name << " in "
+                    << sources[s].path << '\n';
+                continue;
+            }
+
+            Column & column = columns_[name];
+            column.values.assign(num_days_, 0.0f);
+            column.valid.Assign(num_days_, false);
+
+            for (size_t r = 0; r < table.days.size(); r++) {
+                const size_t i = size_t(table.days[r] - first_day_);
+                const bool is_valid = table.valid[c].Test(r);
+                column.values[i] = is_valid ? table.values[c][r] : 0.0f;
+                column.valid.Set(i, is_valid);
+            }
+        }
+    }
+
+    for (auto & name_column : columns_) {
+        Column & column = name_column.second;
+        pool.Submit([&column, this] {
+            column.index.Build(column.values.data(), column.valid,
+                    num_days_);
+        });
+    }
+
+    pool.Wait();
+}
+
+/**
+ * Gets names of all columns.
+ *
+ * @return Column names, sorted.
+ */
+std::vector<std::string> Dataset::GetColumnNames() const {
+
+    std::vector<std::string> names;
+
+    for (const auto & name_column : columns_)
+        names.push_back(name_column.first);
+
+    return names;
+}
+
+/**
+ * Checks whether there is a column with some name.
+ *
+ * @param name Column name.
+ * @return True if there is a column with that name.
+ */
+bool Dataset::HasColumn(const std::string & name) const {
+
+    return FindColumn(name) != nullptr;
+}
+
+/**
+ * Gets first day of the timeline.
+ *
+ * @return First day, counted as number of days since genesis block.
+ */
+int Dataset::GetFirstDay() const {
+
+    return first_day_;
+}
+
+/**
+ * Gets last day of the timeline.
+ *
+ * @return Last day, counted as number of days since genesis block.
+ */
+int Dataset::GetLastDay() const {
+
+    return first_day_ + int(num_days_) - 1;
+}
+
+/**
+ * Gets value of a column on a specific day or -1 if there is no data.
+ *
+ * @param name Column name.
+ * @param day Day, counted as number of days since genesis block.
+ * @return Value or -1.
+ */
+float Dataset::GetValue(const std::string & name, const int day) const {
+
+    return GetAvg(name, day, day + 1);
+}
+
+/**
+ * Gets average value of a column between two days or -1 if there is no
+ * data.
+ *
+ * @param name Column name.
+ * @param day_a First day, counted as number of days since genesis block.
+ * @param day_b Second day, counted as number of days since genesis block.
+ * @return Average value or -1.
+ */
+float Dataset::GetAvg(const std::string & name, const int day_a,
+        const int day_b) const {
+
+    const Column * column = FindColumn(name);
+
+    return column ? column->index.Avg(IndexOfDay(day_a), IndexOfDay(day_b))
+        : -1.0f;
+}
+
+/**
+ * Gets minimum value of a column between two days or -1 if there is no
+ * data.
+ *
+ * @param name Column name.
+ * @param day_a First day, counted as number of days since genesis block.
+ * @param day_b Second day, counted as number of days since genesis block.
+ * @return Minimum value or -1.
+ */
+float Dataset::GetMin(const std::string & name, const int day_a,
+        const int day_b) const {
+
+    const Column * column = FindColumn(name);
+
+    return column ? column->index.Min(IndexOfDay(day_a), IndexOfDay(day_b))
+        : -1.0f;
+}
+
+/**
+ * Gets maximum value of a column between two days or -1 if there is no
+ * data.
+ *
+ * @param name Column name.
+ * @param day_a First day, counted as number of days since genesis block.
+ * @param day_b Second day, counted as number of days since genesis block.
+ * @return Maximum value or -1.
+ */
+float Dataset::GetMax(const std::string & name, const int day_a,
+        const int day_b) const {
+
+    const Column * column = FindColumn(name);
+
+    return column ? column->index.Max(IndexOfDay(day_a), IndexOfDay(day_b))
+        : -1.0f;
+}
+
+/**
+ * Gets sum of values of a column between two days.
+ *
+ * @param name Column name.
+ * @param day_a First day, counted as number of days since genesis block.
+ * @param day_b Second day, counted as number of days since genesis block.
+ * @return Sum of values, or 0 if there is no data.
+ */
+double Dataset::GetSum(const std::string & name, const int day_a,
+        const int day_b) const {
+
+    const Column * column = FindColumn(name);
+
+    return column ? column->index.Sum(IndexOfDay(day_a), IndexOfDay(day_b))
+        : 0.0;
+}
+
+/**
+ * Gets number of days with data of a column between two days.
+ *
+ * @param name Column name.
+ * @param day_a First day, counted as number of days since genesis block.
+ * @param day_b Second day, counted as number of days since genesis block.
+ * @return Number of days with data.
+ */
+int Dataset::GetCount(const std::string & name, const int day_a,
+        const int day_b) const {
+
+    const Column * column = FindColumn(name);
+
+    return column ? int(column->index.Count(IndexOfDay(day_a),
+                IndexOfDay(day_b))) : 0;
+}
+
+/**
+ * Aggregates the values of a column between two times into columns of a
+ * chart, like BtcData::Resample() does with daily prices: column x
+ * aggregates the days from the time at x - 1 to the time at x, with the
+ * time at x being time_a + x * (time_b - time_a) / width, rounded towards
+ * time_a to whole days.
+ *
+ * @param name Column name.
+ * @param time_a First time, in seconds since 1970-01-01 00:00:00 UTC.
+ * @param time_b Second time, in seconds since 1970-01-01 00:00:00 UTC.
+ * @param width Number of columns.
+ * @return Aggregated values of each column, without data if there is no
+ * such column.
+ */
+std::vector<BtcData::ColumnPrices> Dataset::Resample(
+        const std::string & name, const int64_t time_a,
+        const int64_t time_b, const int width) const {
+
+    std::vector<BtcData::ColumnPrices> columns(std::max(width, 0));
+    const Column * column = FindColumn(name);
+
+    if (!column || width <= 0)
+        return columns;
+
+    const int64_t span = time_b - time_a;
+    const int64_t day_seconds = BtcData::kSecondsPerDay_;
+    auto bound = [&](const int x) {
+        return IndexOfDay(DayOfTime(time_a
+                    + x * span / width / day_seconds * day_seconds));
+    };
+
+    size_t a = bound(-1);
+
+    for (int x = 0; x < width; x++) {
+
+        const size_t b = bound(x);
+        const auto stats = kernels::Reduce(column->values.data(),
+                column->valid.Words(), a, b);
+        a = std::max(a, b);
+
+        if (stats.count == 0)
+            continue;
+
+        columns[x].avg = float(stats.sum / stats.count);
+        columns[x].min = stats.min;
+        columns[x].max = stats.max;
+        columns[x].first = column->values[stats.first];
+        columns[x].last = column->values[stats.last];
+    }
+
+    return columns;
+}
+
+/**
+ * Gets the range aggregation index of a column, for arbitrary range
+ * queries. Its positions are obtained from days with IndexOfDay().
+ *
+ * @param name Column name.
+ * @return Range aggregation index, or null if there is no such column.
+ */
+const RangeIndex * Dataset::GetIndex(const std::string & name) const {
+
+    const Column * column = FindColumn(name);
+
+    return column ? &column->index : nullptr;
+}
+
+/**
+ * Gets position of a day in the timeline, clamped to its bounds, so that
+ * the days in [day_a, day_b) are at positions
+ * [IndexOfDay(day_a), IndexOfDay(day_b)).
+ *
+ * @param day Day, counted as number of days since genesis block.
+ * @return Position of the day.
+ */
+size_t Dataset::IndexOfDay(const int day) const {
+
+    return size_t(std::clamp((long long)(day) - first_day_, 0LL,
+                (long long)(num_days_)));
+}
+
+/**
+ * Gets the day of a time, flooring it to the start of its day, also
+ * before 1970.
+ *
+ * @param time Time, in seconds since 1970-01-01 00:00:00 UTC.
+ * @return Day, counted as number of days since genesis block.
+ */
+int Dataset::DayOfTime(const int64_t time) {
+
+    const int64_t seconds = time - BtcData::TimeOfDay(0);
+
+    return int(seconds / BtcData::kSecondsPerDay_
+            - (seconds % BtcData::kSecondsPerDay_ < 0 ? 1 : 0));
+}
+
+/**
+ * Finds a column by name.
+ *
+ * @param name Column name.
+ * @return Pointer to the column, or null if there is no such column.
+ */
+const Dataset::Column * Dataset::FindColumn(const std::string & name)
+    const {
+
+    const auto it = columns_.find(name);
+
+    return (it == columns_.end()) ? nullptr : &it->second;
+}
+
+/**
+ * Extracts the rows of a CSV source, which is memory-mapped and scanned
+ * in place, skipping its first line (titles line) and lines without a
+ * valid time.
+ *
+ * @param source CSV source.
+ * @param table Table to fill with the extracted rows.
+ * @return True if the file could be read.
+ */
+bool Dataset::ExtractTable(const Source & source, Table & table) {
+
+    MappedFile file(source.path);
+
+    if (!file.IsOpen()) {
+        std::cerr << "Error: could not open " << source.path << '\n';
+        return false;
+    }
+
+    const std::string_view contents = file.View();
+
+    table.values.resize(source.columns.size());
+    table.valid.resize(source.columns.size());
+
+    std::vector<std::string_view> fields;
+    size_t pos = std::min(contents.find('\n'), contents.size() - 1) + 1;
+
+    while (pos < contents.size()) {
+
+        const size_t eol = std::min(contents.find('\n', pos),
+                contents.size());
+        std::string_view line = contents.substr(pos, eol - pos);
+        pos = eol + 1;
+
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+
+        // splits the line in fields, reusing the views of the last line
+        fields.clear();
+        for (size_t start = 0; start <= line.size(); ) {
+            const char * comma = static_cast<const char *>(memchr(
+                        line.data() + start, ',', line.size() - start));
+            const size_t end = comma ? size_t(comma - line.data())
+                : line.size();
+            fields.push_back(line.substr(start, end - start));
+            start = end + 1;
+        }
+
+        int64_t time;
+        if (source.time_field >= int(fields.size())
+                || !utils::ParseTime(fields[source.time_field], time))
+            continue;
+
+        table.days.push_back(DayOfTime(time));
+
+        for (size_t c = 0; c < source.columns.size(); c++) {
+            float value = 0.0f;
+            const bool is_valid = ExtractValue(fields, source.columns[c],
+                    value);
+            table.values[c].push_back(value);
+            table.valid[c].PushBack(is_valid);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Extracts the value of a column from the fields of a row, as the average
+ * of its non-empty fields, parsed like the prices of BtcData.
+ *
+ * @param fields Views of the fields of the row.
+ * @param spec Column of the source.
+ * @param value Extracted value.
+ * @return True if the column has data in the row.
+ */
+bool Dataset::ExtractValue(const std::vector<std::string_view> & fields,
+        const ColumnSpec & spec, float & value) {
+
+    const int last_field = (spec.last_field < 0)
+        ? int(fields.size()) - 1
+        : std::min(spec.last_field, int(fields.size()) - 1);
+
+    if (spec.first_field > last_field)
+        return false;
+
+    // the fields are views of the same line, so they are parsed at once
+    const char * const begin = fields[spec.first_field].data();
+    const char * const end = fields[last_field].data()
+        + fields[last_field].size();
+
+    return utils::ParseAverage(std::string_view(begin, size_t(end - begin)),
+            nullptr, 0, value) > 0;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "bitmap.h"
+#include "btc_data.h"
+#include "range_index.h"
+#include "thread_pool.h"
+
+
+/**
+ * Columnar dataset class.
+ *
+ * Loads several CSV sources concurrently and aligns all their columns on a
+ * single timeline with one position per day since genesis block, from the
+ * first to the last day of any source. Every column is named, has its own
+ * validity bitmap for days without data and is queried through its own
+ * range aggregation index.
+ */
+class Dataset {
+public:
+    /// Column of a CSV source data structure. Its value is the average of
+    /// the non-empty fields from first_field to last_field (or to the last
+    /// field if it is negative).
+    struct ColumnSpec {
+        std::string name; ///< Column name, unique in the dataset.
+        int first_field = 0, last_field = 0; ///< Fields, counted from 0.
+    };
+
+    /// CSV source data structure, with a titles line and one row per line.
+    /// When a day has several rows, the last one is kept.
+    struct Source {
+        std::string path; ///< CSV file path.
+        int time_field = 0; ///< Field with the time of each row.
+        std::vector<ColumnSpec> columns; ///< Columns taken from the file.
+    };
+
+    static Source BitcoinityPrice(const std::string & path
+            = "data/bitcoinity_price.csv");
+    static Source BitcoinityTimeBetweenBlocks(const std::string & path
+            = "data/bitcoinity_time_between_blocks.csv");
+    static Source CoinBitcoin(const std::string & path
+            = "data/coin_Bitcoin.csv");
+
+    // constructor
+    explicit Dataset(const std::vector<Source> & sources,
+            const int num_threads = ThreadPool::DefaultNumThreads());
+
+    // public functions
+    std::vector<std::string> GetColumnNames() const;
+    bool HasColumn(const std::string & name) const;
+    int GetFirstDay() const;
+    int GetLastDay() const;
+
+    float GetValue(const std::string & name, const int day) const;
+    float GetAvg(const std::string & name, const int day_a,
+            const int day_b) const;
+    float GetMin(const std::string & name, const int day_a,
+            const int day_b) const;
+    float GetMax(const std::string & name, const int day_a,
+            const int day_b) const;
+    double GetSum(const std::string & name, const int day_a,
+            const int day_b) const;
+    int GetCount(const std::string & name, const int day_a,
+            const int day_b) const;
+    std::vector<BtcData::ColumnPrices> Resample(const std::string & name,
+            const int64_t time_a, const int64_t time_b,
+            const int width) const;
+
+    const RangeIndex * GetIndex(const std::string & name) const;
+    size_t IndexOfDay(const int day) const;
+
+private:
+    /// Column aligned on the timeline data structure.
+    struct Column {
+        std::vector<float> values; ///< Values, or 0 if there is no data.
+        Bitmap valid; ///< Whether there is data for each day.
+        RangeIndex index; ///< Range aggregation index of values.
+    };
+
+    /// Rows extracted from a CSV source data structure, where each column
+    /// has one value per row.
+    struct Table {
+        std::vector<int> days; ///< Days since genesis block.
+        std::vector<std::vector<float>> values; ///< Values of each column.
+        std::vector<Bitmap> valid; ///< Validity of each column.
+    };
+
+    int first_day_ = 0; ///< First day of the timeline.
+    size_t num_days_ = 0; ///< Number of days of the timeline.
+    std::map<std::string, Column> columns_; ///< Columns, by name.
+
+    // helper functions
+    const Column * FindColumn(const std::string & name) const;
+    static int DayOfTime(const int64_t time);
+    static bool ExtractTable(const Source & source, Table & table);
+    static bool ExtractValue(const std::vector<std::string_view> & fields,
+            const ColumnSpec & spec, float & value);
+};
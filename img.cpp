@@ -1,48 +1,603 @@
 #include <iostream>
-#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <Magick++.h>
 #include "img.h"
 
 
 /**
  * Constructor.
- * Creates the image and sets its background.
+ * Creates the image with a transparent background.
  *
  * @param width,height Image width ang height sizes.
  */
-Img::Img(const int width, const int height) {
+Img::Img(const int width, const int height)
+    : width_(std::max(width, 0)), height_(std::max(height, 0)),
+        pixels_(size_t(width_) * height_ * 4, 0) {}
 
-    img_ = Magick::Image(Magick::Geometry(width, height),
-            Magick::Color(0, 0, 0, 0));
+/**
+ * Draws line on image.
+ *
+ * @param start_x,start_y Line start coordinates.
+ * @param end_x,end_y Line end coordinates.
+ * @param color Line color, as '#RRGGBB' or '#RRGGBBAA'.
+ */
+void Img::DrawLine(const float start_x, const float start_y,
+        const float end_x, const float end_y, const std::string & color) {
+
+    DrawLine(start_x, start_y, end_x, end_y, ParseColor(color));
 }
 
 /**
- * Draws line on image.
+ * Draws anti-aliased line on image.
  *
  * @param start_x,start_y Line start coordinates.
  * @param end_x,end_y Line end coordinates.
  * @param color Line color.
  */
 void Img::DrawLine(const float start_x, const float start_y,
-        const float end_x, const float end_y, const std::string & color) {
+        const float end_x, const float end_y, const utils::RGBA & color) {
+
+    RasterLine(start_x, start_y, end_x, end_y, color, {0, width_});
+}
+
+/**
+ * Draws anti-aliased polyline on image.
+ *
+ * @param points Polyline points, in order.
+ * @param color Polyline color.
+ */
+void Img::DrawPolyline(const std::vector<Point> & points,
+        const utils::RGBA & color) {
+
+    RasterPolyline(points, color, {0, width_});
+}
+
+/**
+ * Fills rectangle on image.
+ *
+ * @param x_a,y_a Rectangle top left pixel coordinates.
+ * @param x_b,y_b Rectangle bottom right pixel coordinates, excluded.
+ * @param color Fill color.
+ */
+void Img::FillRect(const int x_a, const int y_a, const int x_b,
+        const int y_b, const utils::RGBA & color) {
+
+    RasterRect(x_a, y_a, x_b, y_b, color, {0, width_});
+}
+
+/**
+ * Fills horizontal span of pixels on image.
+ *
+ * @param y Span row.
+ * @param x_a First pixel of the span.
+ * @param x_b One past last pixel of the span.
+ * @param color Fill color.
+ */
+void Img::FillSpan(const int y, const int x_a, const int x_b,
+        const utils::RGBA & color) {
+
+    RasterSpan(y, x_a, x_b, color, {0, width_});
+}
+
+/**
+ * Records polyline in the draw list.
+ *
+ * @param points Polyline points, in order.
+ * @param color Polyline color.
+ */
+void Img::AddPolyline(std::vector<Point> points, const utils::RGBA & color) {
+
+    commands_.push_back({Command::kPolyline, color, std::move(points)});
+}
+
+/**
+ * Records filled rectangle in the draw list.
+ *
+ * @param x_a,y_a Rectangle top left pixel coordinates.
+ * @param x_b,y_b Rectangle bottom right pixel coordinates, excluded.
+ * @param color Fill color.
+ */
+void Img::AddRect(const int x_a, const int y_a, const int x_b,
+        const int y_b, const utils::RGBA & color) {
+
+    commands_.push_back({Command::kRect, color,
+            {{float(x_a), float(y_a)}, {float(x_b), float(y_b)}}});
+}
+
+/**
+ * Records text in the draw list.
+ *
+ * @param x,y Text baseline start coordinates.
+ * @param text Text.
+ * @param size Font size in points.
+ * @param color Text color.
+ */
+void Img::AddText(const float x, const float y, const std::string & text,
+        const float size, const utils::RGBA & color) {
+
+    texts_.push_back({x, y, text, size, color});
+}
+
+/**
+ * Draws all shapes recorded in the draw list, in order, and clears it.
+ *
+ * The image can be split in vertical strips drawn in parallel, each one by
+ * its own thread. Every thread draws the whole list clipped to its strip,
+ * so shapes crossing strip edges are drawn exactly as by a single thread.
+ *
+ * @param num_threads Number of threads, and strips.
+ */
+void Img::Flush(const int num_threads) {
+
+    const int num_strips = std::clamp(num_threads, 1, std::max(width_, 1));
+    const int strip_width = (width_ + num_strips - 1) / num_strips;
+
+    auto strip = [&](const int i) {
+        return Clip{std::min(i * strip_width, width_),
+            std::min((i + 1) * strip_width, width_)};
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < num_strips; i++)
+        threads.emplace_back(&Img::FlushStrip, this, strip(i));
+    FlushStrip(strip(0));
+    for (auto & thread : threads)
+        thread.join();
+
+    commands_.clear();
+}
+
+/**
+ * Gets image width.
+ *
+ * @return Width in pixels.
+ */
+int Img::Width() const {
 
-    img_.strokeColor(Magick::Color(color));
-    img_.draw(Magick::DrawableLine(start_x, start_y, end_x, end_y));
+    return width_;
+}
+
+/**
+ * Gets image height.
+ *
+ * @return Height in pixels.
+ */
+int Img::Height() const {
+
+    return height_;
+}
+
+/**
+ * Gets framebuffer pixels, as RGBA bytes row by row.
+ *
+ * @return Pointer to the first pixel.
+ */
+const uint8_t * Img::Pixels() const {
+
+    return pixels_.data();
+}
+
+/**
+ * Sets options of the built-in PNG encoder.
+ *
+ * @param png_options PNG encoding options.
+ */
+void Img::SetPngOptions(const PngWriter::Options & png_options) {
 
+    png_options_ = png_options;
 }
 
 /**
- * Writes image in path.
+ * Encodes image in memory, flushing the draw list first.
+ *
+ * @param format Image format, such as 'PNG'.
+ * @param bytes Caller-owned buffer where the encoded image is stored.
+ */
+void Img::Encode(const std::string & format, std::vector<uint8_t> & bytes) {
+
+    Flush();
+
+    if (format == "PNG" && texts_.empty()) {
+        PngWriter::Encode(pixels_.data(), width_, height_, png_options_,
+                bytes);
+        return;
+    }
+
+    Magick::Image img(width_, height_, "RGBA", Magick::CharPixel,
+            pixels_.data());
+
+    // draws all text in a single call
+    if (!texts_.empty()) {
+        std::vector<Magick::Drawable> drawables;
+        for (const auto & text : texts_) {
+            const Magick::Color color(ColorToString(text.color));
+            drawables.push_back(Magick::DrawableFillColor(color));
+            drawables.push_back(Magick::DrawablePointSize(text.size));
+            drawables.push_back(Magick::DrawableText(text.x, text.y,
+                        text.text));
+        }
+        img.draw(drawables);
+    }
+
+    Magick::Blob blob;
+    img.magick(format);
+    img.write(&blob);
+
+    const auto * data = static_cast<const uint8_t *>(blob.data());
+    bytes.assign(data, data + blob.length());
+}
+
+/**
+ * Encodes image and writes it to a file descriptor, such as a pipe or a
+ * socket. The descriptor is not closed.
+ *
+ * @param fd File descriptor.
+ * @param format Image format, such as 'PNG'.
+ * @return True if the whole image could be written.
+ */
+bool Img::WriteFd(const int fd, const std::string & format) {
+
+    std::vector<uint8_t> bytes;
+    Encode(format, bytes);
+
+    return WriteBytes(fd, bytes);
+}
+
+/**
+ * Writes image in path, in the format given by the path extension.
  *
  * @param path Path where image should be written.
  */
 void Img::Write(const std::string & path) {
 
-    std::ofstream file(path, std::ios::trunc); // creates or truncates file
-    if (file.is_open()) {
-        file.close(); // closes file
-        img_.write(path); // writes img in file
-    } else {
+    std::vector<uint8_t> bytes;
+    Encode(FormatOfPath(path), bytes);
+
+    // creates or truncates file
+    const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
         std::cerr << "Error: could not open " << path << '\n';
+        return;
+    }
+
+    if (!WriteBytes(fd, bytes))
+        std::cerr << "Error: could not write " << path << '\n';
+
+    close(fd);
+}
+
+/**
+ * Parses color string.
+ *
+ * @param color Color, as '#RRGGBB' or '#RRGGBBAA'.
+ * @return RGBA color, or opaque black if the string is not valid.
+ */
+utils::RGBA Img::ParseColor(const std::string & color) {
+
+    utils::RGBA rgba = {0, 0, 0, 255};
+
+    if (color.size() != 7 && color.size() != 9)
+        return rgba;
+    if (color[0] != '#')
+        return rgba;
+
+    for (size_t i = 0; i < (color.size() - 1) / 2; i++) {
+        const std::string hex = color.substr(1 + 2 * i, 2);
+        rgba[i] = int(std::strtol(hex.c_str(), nullptr, 16));
+    }
+
+    return rgba;
+}
+
+/**
+ * Draws all shapes recorded in the draw list, in order, clipped to a strip.
+ *
+ * @param clip Strip of the image to draw on.
+ */
+void Img::FlushStrip(const Clip clip) {
+
+    for (const auto & command : commands_) {
+        switch (command.type) {
+            case Command::kPolyline:
+                RasterPolyline(command.points, command.color, clip);
+                break;
+            case Command::kRect:
+                RasterRect(int(command.points[0].x), int(command.points[0].y),
+                        int(command.points[1].x), int(command.points[1].y),
+                        command.color, clip);
+                break;
+        }
+    }
+}
+
+/**
+ * Clips a line to a rectangle, with the Liang-Barsky algorithm. Endpoints
+ * inside the rectangle are left untouched.
+ *
+ * @param x0,y0 Line start coordinates, moved to the rectangle if needed.
+ * @param x1,y1 Line end coordinates, moved to the rectangle if needed.
+ * @param x_min,y_min Top left corner of the rectangle.
+ * @param x_max,y_max Bottom right corner of the rectangle.
+ * @return False if the line is outside the rectangle.
+ */
+bool Img::ClipLine(float & x0, float & y0, float & x1, float & y1,
+        const float x_min, const float y_min, const float x_max,
+        const float y_max) {
+
+    // in double precision, so differences of huge floats do not overflow
+    const double dx = double(x1) - x0, dy = double(y1) - y0;
+    const double p[] = {-dx, dx, -dy, dy};
+    const double bounds[] = {x_min, x_max, y_min, y_max};
+    const double q[] = {double(x0) - x_min, x_max - double(x0),
+        double(y0) - y_min, y_max - double(y0)};
+
+    double t0 = 0.0, t1 = 1.0;
+    int k0 = -1, k1 = -1; // boundaries that cut the line at t0 and t1
+
+    for (int k = 0; k < 4; k++) {
+        if (p[k] == 0.0) {
+            if (q[k] < 0.0)
+                return false;
+        } else if (p[k] < 0.0 && q[k] / p[k] > t0) {
+            t0 = q[k] / p[k];
+            k0 = k;
+        } else if (p[k] > 0.0 && q[k] / p[k] < t1) {
+            t1 = q[k] / p[k];
+            k1 = k;
+        }
+    }
+
+    if (t0 > t1)
+        return false;
+
+    // moves an end onto the boundary that cuts the line, interpolating the
+    // other coordinate from the start, as huge t * d products would lose
+    // the precision of the result
+    const double start_x = x0, start_y = y0;
+    auto cut = [&](const int k, float & x, float & y) {
+        if (k < 2) {
+            x = float(bounds[k]);
+            y = float(start_y + (bounds[k] - start_x) * (dy / dx));
+        } else {
+            y = float(bounds[k]);
+            x = float(start_x + (bounds[k] - start_y) * (dx / dy));
+        }
+    };
+
+    if (k1 >= 0)
+        cut(k1, x1, y1);
+    if (k0 >= 0)
+        cut(k0, x0, y0);
+
+    return true;
+}
+
+/**
+ * Draws anti-aliased line on a strip of the image, with Xiaolin Wu's
+ * algorithm.
+ *
+ * @param start_x,start_y Line start coordinates.
+ * @param end_x,end_y Line end coordinates.
+ * @param color Line color.
+ * @param clip Strip of the image to draw on.
+ */
+void Img::RasterLine(const float start_x, const float start_y,
+        const float end_x, const float end_y, const utils::RGBA & color,
+        const Clip clip) {
+
+    if (!std::isfinite(start_x) || !std::isfinite(start_y)
+            || !std::isfinite(end_x) || !std::isfinite(end_y))
+        return;
+
+    float x0 = start_x, y0 = start_y, x1 = end_x, y1 = end_y;
+
+    // clips the line to the strip, with a margin for the anti-aliased
+    // pixels of its ends, so every coordinate can be converted to int
+    if (!ClipLine(x0, y0, x1, y1, float(clip.x_a - 2), -2.0f,
+                float(clip.x_b + 1), float(height_ + 1)))
+        return;
+
+    // walks along the major axis, from left to right
+    const bool is_steep = std::fabs(y1 - y0) > std::fabs(x1 - x0);
+    if (is_steep) {
+        std::swap(x0, y0);
+        std::swap(x1, y1);
+    }
+    if (x0 > x1) {
+        std::swap(x0, x1);
+        std::swap(y0, y1);
+    }
+
+    const float dx = x1 - x0;
+    const float gradient = (dx == 0.0f) ? 1.0f : (y1 - y0) / dx;
+
+    auto plot = [&](const int major, const int minor, const float coverage) {
+        if (is_steep)
+            BlendPixel(minor, major, color, coverage, clip);
+        else
+            BlendPixel(major, minor, color, coverage, clip);
+    };
+
+    auto fpart = [](const float v) { return v - std::floor(v); };
+
+    // first endpoint
+    const float x_end0 = std::round(x0);
+    const float y_end0 = y0 + gradient * (x_end0 - x0);
+    const float x_gap0 = 1.0f - fpart(x0 + 0.5f);
+    const int x_pixel0 = int(x_end0);
+    plot(x_pixel0, int(std::floor(y_end0)), (1.0f - fpart(y_end0)) * x_gap0);
+    plot(x_pixel0, int(std::floor(y_end0)) + 1, fpart(y_end0) * x_gap0);
+
+    // second endpoint
+    const float x_end1 = std::round(x1);
+    const float y_end1 = y1 + gradient * (x_end1 - x1);
+    const float x_gap1 = fpart(x1 + 0.5f);
+    const int x_pixel1 = int(x_end1);
+    if (x_pixel1 != x_pixel0) {
+        plot(x_pixel1, int(std::floor(y_end1)),
+                (1.0f - fpart(y_end1)) * x_gap1);
+        plot(x_pixel1, int(std::floor(y_end1)) + 1, fpart(y_end1) * x_gap1);
+    }
+
+    // pixels between both endpoints, only within the image, and within
+    // the strip when the major axis is x
+    int x_a = std::max(x_pixel0 + 1, 0);
+    int x_b = std::min(x_pixel1, is_steep ? height_ : width_);
+    if (!is_steep) {
+        x_a = std::max(x_a, clip.x_a);
+        x_b = std::min(x_b, clip.x_b);
+    }
+
+    for (int x = x_a; x < x_b; x++) {
+        const float inter_y = y_end0 + gradient * (x - x_pixel0);
+        const int y = int(std::floor(inter_y));
+        plot(x, y, 1.0f - fpart(inter_y));
+        plot(x, y + 1, fpart(inter_y));
+    }
+}
+
+/**
+ * Draws anti-aliased polyline on a strip of the image.
+ *
+ * @param points Polyline points, in order.
+ * @param color Polyline color.
+ * @param clip Strip of the image to draw on.
+ */
+void Img::RasterPolyline(const std::vector<Point> & points,
+        const utils::RGBA & color, const Clip clip) {
+
+    for (size_t i = 1; i < points.size(); i++)
+        RasterLine(points[i - 1].x, points[i - 1].y, points[i].x,
+                points[i].y, color, clip);
+}
+
+/**
+ * Fills rectangle on a strip of the image.
+ *
+ * @param x_a,y_a Rectangle top left pixel coordinates.
+ * @param x_b,y_b Rectangle bottom right pixel coordinates, excluded.
+ * @param color Fill color.
+ * @param clip Strip of the image to draw on.
+ */
+void Img::RasterRect(const int x_a, const int y_a, const int x_b,
+        const int y_b, const utils::RGBA & color, const Clip clip) {
+
+    for (int y = std::max(y_a, 0); y < std::min(y_b, height_); y++)
+        RasterSpan(y, x_a, x_b, color, clip);
+}
+
+/**
+ * Fills horizontal span of pixels on a strip of the image.
+ *
+ * @param y Span row.
+ * @param x_a First pixel of the span.
+ * @param x_b One past last pixel of the span.
+ * @param color Fill color.
+ * @param clip Strip of the image to draw on.
+ */
+void Img::RasterSpan(const int y, const int x_a, const int x_b,
+        const utils::RGBA & color, const Clip clip) {
+
+    if (y < 0 || y >= height_)
+        return;
+
+    for (int x = std::max(x_a, clip.x_a); x < std::min(x_b, clip.x_b); x++)
+        BlendPixel(x, y, color, 1.0f, clip);
+}
+
+/**
+ * Converts color to string.
+ *
+ * @param color RGBA color.
+ * @return Color as '#RRGGBBAA'.
+ */
+std::string Img::ColorToString(const utils::RGBA & color) {
+
+    char str[10];
+    snprintf(str, sizeof(str), "#%02x%02x%02x%02x", color[0], color[1],
+            color[2], color[3]);
+
+    return str;
+}
+
+/**
+ * Gets image format from path extension.
+ *
+ * @param path Image path.
+ * @return Upper case extension, or 'PNG' if the path has no extension.
+ */
+std::string Img::FormatOfPath(const std::string & path) {
+
+    const size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos || path.find('/', dot) != std::string::npos)
+        return "PNG";
+
+    std::string format = path.substr(dot + 1);
+    for (char & c : format)
+        c = char(toupper(c));
+
+    return format;
+}
+
+/**
+ * Writes all bytes to a file descriptor, retrying on partial writes.
+ *
+ * @param fd File descriptor.
+ * @param bytes Bytes to write.
+ * @return True if all bytes could be written.
+ */
+bool Img::WriteBytes(const int fd, const std::vector<uint8_t> & bytes) {
+
+    size_t written = 0;
+
+    while (written < bytes.size()) {
+        const ssize_t n = write(fd, bytes.data() + written,
+                bytes.size() - written);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        written += size_t(n);
+    }
+
+    return true;
+}
+
+/**
+ * Blends color over pixel, with source-over compositing.
+ *
+ * @param x,y Pixel coordinates, ignored if outside the image or the strip.
+ * @param color Color to blend.
+ * @param coverage Fraction of the pixel covered by the color (0-1).
+ * @param clip Strip of the image to draw on.
+ */
+void Img::BlendPixel(const int x, const int y, const utils::RGBA & color,
+        const float coverage, const Clip clip) {
+
+    if (x < clip.x_a || x >= clip.x_b || y < 0 || y >= height_
+            || coverage <= 0.0f)
+        return;
+
+    uint8_t * pixel = &pixels_[(size_t(y) * width_ + x) * 4];
+
+    const float src_a = color[3] / 255.0f * std::min(coverage, 1.0f);
+    const float dst_a = pixel[3] / 255.0f;
+    const float out_a = src_a + dst_a * (1.0f - src_a);
+
+    if (out_a <= 0.0f)
+        return;
+
+    for (int c = 0; c < 3; c++) {
+        const float out_c = (color[c] * src_a
+                + pixel[c] * dst_a * (1.0f - src_a)) / out_a;
+        pixel[c] = uint8_t(std::lround(out_c));
     }
-    
+    pixel[3] = uint8_t(std::lround(out_a * 255.0f));
 }
@@ -1,14 +1,31 @@
 #pragma once
 
-#include <Magick++.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "png_writer.h"
 #include "utils.h"
 
 
 /**
  * Image class.
+ *
+ * Images are drawn by our own rasterizer on an RGBA framebuffer, with
+ * straight (not premultiplied) alpha. Magick++ is only used to encode the
+ * framebuffer in formats other than PNG, or when there is text to draw.
+ * PNG images are otherwise encoded by PngWriter.
+ *
+ * Shapes can be drawn right away, or recorded in a draw list and drawn
+ * all together by Flush(). Recorded text is drawn on top of everything
+ * else, in a single Magick++ draw call when the image is written.
  */
 class Img {
 public:
+    /// Point data structure.
+    struct Point {
+        float x, y;
+    };
+
     // constructor
     Img(const int width, const int height);
 
@@ -17,9 +34,82 @@ public:
     void DrawLine(const float start_x, const float start_y,
             const float end_x, const float end_y,
             const std::string & color);
+    void DrawLine(const float start_x, const float start_y,
+            const float end_x, const float end_y,
+            const utils::RGBA & color);
+    void DrawPolyline(const std::vector<Point> & points,
+            const utils::RGBA & color);
+    void FillRect(const int x_a, const int y_a, const int x_b, const int y_b,
+            const utils::RGBA & color);
+    void FillSpan(const int y, const int x_a, const int x_b,
+            const utils::RGBA & color);
+
+    void AddPolyline(std::vector<Point> points, const utils::RGBA & color);
+    void AddRect(const int x_a, const int y_a, const int x_b, const int y_b,
+            const utils::RGBA & color);
+    void AddText(const float x, const float y, const std::string & text,
+            const float size, const utils::RGBA & color);
+    void Flush(const int num_threads = 1);
 
+    int Width() const;
+    int Height() const;
+    const uint8_t * Pixels() const;
+
+    void SetPngOptions(const PngWriter::Options & png_options);
+    void Encode(const std::string & format, std::vector<uint8_t> & bytes);
+    bool WriteFd(const int fd, const std::string & format);
     void Write(const std::string & path);
 
+    static utils::RGBA ParseColor(const std::string & color);
+
 private:
-    Magick::Image img_ = NULL; ///< Magick++ Image object.
+    /// Vertical strip of the image data structure, where pixel columns in
+    /// [x_a, x_b) can be drawn.
+    struct Clip {
+        int x_a, x_b;
+    };
+
+    /// Recorded shape drawing command data structure.
+    struct Command {
+        enum Type {kPolyline, kRect} type;
+        utils::RGBA color;
+        /// Polyline points, or top left and bottom right rectangle corners.
+        std::vector<Point> points;
+    };
+
+    /// Recorded text drawing command data structure.
+    struct TextCommand {
+        float x, y;
+        std::string text;
+        float size;
+        utils::RGBA color;
+    };
+
+    int width_, height_; ///< Image width and height sizes.
+    std::vector<uint8_t> pixels_; ///< RGBA framebuffer, row by row.
+
+    std::vector<Command> commands_; ///< Draw list of shapes to flush.
+    std::vector<TextCommand> texts_; ///< Draw list of text to write.
+
+    PngWriter::Options png_options_; ///< Built-in PNG encoder options.
+
+    // helper functions
+    void FlushStrip(const Clip clip);
+    static bool ClipLine(float & x0, float & y0, float & x1, float & y1,
+            const float x_min, const float y_min, const float x_max,
+            const float y_max);
+    void RasterLine(const float start_x, const float start_y,
+            const float end_x, const float end_y,
+            const utils::RGBA & color, const Clip clip);
+    void RasterPolyline(const std::vector<Point> & points,
+            const utils::RGBA & color, const Clip clip);
+    void RasterRect(const int x_a, const int y_a, const int x_b,
+            const int y_b, const utils::RGBA & color, const Clip clip);
+    void RasterSpan(const int y, const int x_a, const int x_b,
+            const utils::RGBA & color, const Clip clip);
+    static std::string ColorToString(const utils::RGBA & color);
+    static std::string FormatOfPath(const std::string & path);
+    static bool WriteBytes(const int fd, const std::vector<uint8_t> & bytes);
+    void BlendPixel(const int x, const int y, const utils::RGBA & color,
+            const float coverage, const Clip clip);
 };
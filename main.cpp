@@ -2,18 +2,140 @@
  * @file main.cpp
  * Main file containing project's main function.
  */
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <string>
 #include "utils.h"
 #include "btc_chart.h"
+#include "btc_data_watcher.h"
+#include "chart_batch.h"
+#include "thread_pool.h"
+#include "trade_stream.h"
+
+namespace {
+
+/// Maximum bucket size of trades accepted as argument, a year in seconds.
+const int64_t kMaxBucketSize = 366 * 24 * 60 * 60;
+
+/// Maximum number of worker threads accepted as argument.
+const int kMaxNumThreads = 1024;
+
+}
+
+/**
+ * Prints the command line usage.
+ *
+ * @param program Name the program was run with.
+ */
+static void PrintUsage(const char * program) {
+
+    std::cerr << "Usage: " << program << '\n'
+        << "       " << program << " [--watch] manifest [num_threads]\n"
+        << "       " << program
+        << " --trades trades_file bucket_seconds manifest [num_threads]\n";
+}
+
+/**
+ * Parses a whole argument as an integer within a range.
+ *
+ * @param arg Argument.
+ * @param min,max Smallest and largest accepted values.
+ * @param number Parsed integer, only set when the argument is valid.
+ * @return False if the argument is not an integer within the range.
+ */
+template <typename T>
+static bool ParseArg(const char * arg, const T min, const T max, T & number) {
+
+    const char * const end = arg + std::strlen(arg);
+
+    T value;
+    const auto res = std::from_chars(arg, end, value);
+    if (res.ec != std::errc() || res.ptr != end || value < min
+            || value > max) {
+        std::cerr << "Error: invalid argument " << arg << '\n';
+        return false;
+    }
+
+    number = value;
+    return true;
+}
 
 /**
  * Main function.
+ *
+ * Without arguments generates the default chart. With a manifest file as
+ * first argument generates every chart in it, with as many worker threads
+ * as given by the optional second argument. With '--watch' before the
+ * manifest file, keeps running and generates the charts again whenever
+ * the Bitcoin data file changes. With '--trades', a trades file and a
+ * bucket size in seconds before the manifest file, draws the charts from
+ * the trades aggregated into buckets instead.
  */
-int main() {
+int main(int argc, char ** argv) {
+
+    if (argc > 1 && std::string(argv[1]) == "--trades") {
+
+        int64_t bucket_size = 0;
+        int num_threads = ThreadPool::DefaultNumThreads();
+        if (argc < 5 || argc > 6
+                || !ParseArg(argv[3], int64_t(1), kMaxBucketSize,
+                    bucket_size)
+                || (argc > 5 && !ParseArg(argv[5], 1, kMaxNumThreads,
+                        num_threads))) {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+
+        auto btc_data = std::make_shared<BtcData>("");
+        TradeStream trade_stream(bucket_size);
+        if (!trade_stream.Ingest(argv[2], *btc_data))
+            return 1;
+
+        ChartBatch batch;
+        if (!batch.ReadManifest(argv[4]))
+            return 1;
+
+        batch.Run(btc_data, num_threads);
+        return 0;
+    }
+
+    const bool is_watching = (argc > 1 && std::string(argv[1]) == "--watch");
+    const int arg = is_watching ? 2 : 1;
+
+    if (argc > arg) {
+
+        int num_threads = ThreadPool::DefaultNumThreads();
+        if (argc > arg + 2 || (argc > arg + 1
+                    && !ParseArg(argv[arg + 1], 1, kMaxNumThreads,
+                        num_threads))) {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+
+        ChartBatch batch;
+        if (!batch.ReadManifest(argv[arg]))
+            return 1;
+
+        if (!is_watching) {
+            batch.Run(BtcData::Get(), num_threads);
+            return 0;
+        }
+
+        BtcDataWatcher watcher;
+        auto btc_data = watcher.GetSnapshot();
+
+        while (true) {
+            batch.Run(btc_data, num_threads);
+            btc_data = watcher.WaitForUpdate(btc_data);
+        }
+    }
 
-    BtcChart::Cfg cfg = BtcChart::Cfg(1024, 576, 0, 5000,
-            0.1f * 0.9f, 10000000.0f * 1.1f, utils::kLogarithmic);
+    BtcChart::Cfg cfg = BtcChart::Cfg(1024, 576, BtcData::TimeOfDay(0),
+            BtcData::TimeOfDay(5000), 0.1f * 0.9f, 10000000.0f * 1.1f,
+            utils::kLogarithmic);
 
-    BtcChart btc_chart;
+    BtcChart btc_chart(BtcData::Get());
     btc_chart.Generate("charts/chart.png", cfg);
 
     return 0;
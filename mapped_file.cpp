@@ -0,0 +1,70 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "mapped_file.h"
+
+
+/**
+ * Constructor.
+ * Opens the file and maps all of it into memory.
+ *
+ * @param path Path of the file to map.
+ */
+MappedFile::MappedFile(const std::string & path) {
+
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+
+        size_ = size_t(st.st_size);
+        is_open_ = true;
+
+        // empty files can not be mapped, but are still valid files
+        if (size_ > 0) {
+            void * addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                size_ = 0;
+                is_open_ = false;
+            } else {
+                data_ = static_cast<const char *>(addr);
+                madvise(addr, size_, MADV_SEQUENTIAL);
+            }
+        }
+    }
+
+    close(fd); // the mapping stays valid after closing the descriptor
+}
+
+/**
+ * Destructor.
+ * Unmaps the file.
+ */
+MappedFile::~MappedFile() {
+
+    if (data_)
+        munmap(const_cast<char *>(data_), size_);
+}
+
+/**
+ * Checks whether the file could be opened and mapped.
+ *
+ * @return True if the file is mapped.
+ */
+bool MappedFile::IsOpen() const {
+
+    return is_open_;
+}
+
+/**
+ * Gets a view of the whole file contents.
+ *
+ * @return View of the mapped bytes.
+ */
+std::string_view MappedFile::View() const {
+
+    return std::string_view(data_, size_);
+}
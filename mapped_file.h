@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+
+/**
+ * Read-only memory-mapped file class.
+ */
+class MappedFile {
+public:
+    // constructor and destructor
+    explicit MappedFile(const std::string & path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+
+    // public functions
+    bool IsOpen() const;
+    std::string_view View() const;
+
+private:
+    const char * data_ = nullptr; ///< Start of the mapped file contents.
+    size_t size_ = 0; ///< Size of the mapped file in bytes.
+    bool is_open_ = false; ///< Whether the file could be opened.
+};
@@ -0,0 +1,330 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+#include <zlib.h>
+#include "png_writer.h"
+
+
+/// Minimum number of rows compressed by each thread.
+const int PngWriter::kMinChunkRows_ = 64;
+
+/**
+ * Encodes an RGBA framebuffer as PNG.
+ *
+ * @param rgba RGBA pixels, row by row, with straight alpha.
+ * @param width,height Image width and height sizes.
+ * @param options Encoding options.
+ * @param bytes Caller-owned buffer where the PNG file is stored.
+ */
+void PngWriter::Encode(const uint8_t * rgba, const int width,
+        const int height, const Options & options,
+        std::vector<uint8_t> & bytes) {
+
+    const size_t num_pixels = size_t(width) * height;
+
+    std::vector<uint32_t> palette;
+    std::vector<uint8_t> indexes;
+    const bool is_indexed = options.allow_palette
+        && MakePalette(rgba, num_pixels, palette, indexes);
+
+    // smallest bit depth that fits the palette
+    int bit_depth = 8;
+    if (is_indexed)
+        bit_depth = (palette.size() <= 2) ? 1 : (palette.size() <= 4) ? 2
+            : (palette.size() <= 16) ? 4 : 8;
+
+    const size_t bpp = is_indexed ? 1 : 4;
+    const size_t row_bytes = is_indexed
+        ? (size_t(width) * bit_depth + 7) / 8 : size_t(width) * 4;
+
+    Filter filter = options.filter;
+    if (filter == kFilterAuto)
+        filter = is_indexed ? kFilterNone : kFilterAdaptive;
+
+    // packs and filters rows, each one preceded by its filter type byte
+    std::vector<uint8_t> filtered((row_bytes + 1) * height);
+    std::vector<uint8_t> row(row_bytes), prev_row(row_bytes, 0);
+
+    for (int y = 0; y < height; y++) {
+
+        if (is_indexed) {
+            std::fill(row.begin(), row.end(), 0);
+            const uint8_t * row_indexes = &indexes[size_t(y) * width];
+            for (int x = 0; x < width; x++) {
+                const size_t bit = size_t(x) * bit_depth;
+                row[bit / 8] |= uint8_t(row_indexes[x]
+                        << (8 - bit_depth - bit % 8));
+            }
+        } else {
+            memcpy(row.data(), rgba + size_t(y) * row_bytes, row_bytes);
+        }
+
+        FilterRow(filter, row.data(), prev_row.data(), row_bytes, bpp,
+                &filtered[(row_bytes + 1) * y]);
+        std::swap(row, prev_row);
+    }
+
+    std::vector<uint8_t> stream;
+    Compress(filtered, row_bytes, height, options, stream);
+
+    // writes file
+    static const uint8_t signature[] = {137, 80, 78, 71, 13, 10, 26, 10};
+    bytes.assign(signature, signature + sizeof(signature));
+
+    uint8_t ihdr[13];
+    const uint32_t size[] = {uint32_t(width), uint32_t(height)};
+    for (int i = 0; i < 8; i++)
+        ihdr[i] = uint8_t(size[i / 4] >> (24 - 8 * (i % 4)));
+    ihdr[8] = uint8_t(bit_depth);
+    ihdr[9] = is_indexed ? 3 : 6; // indexed or RGBA color type
+    ihdr[10] = ihdr[11] = ihdr[12] = 0;
+    AppendChunk("IHDR", ihdr, sizeof(ihdr), bytes);
+
+    if (is_indexed) {
+
+        std::vector<uint8_t> plte, trns;
+        for (const uint32_t color : palette) {
+            for (int c = 0; c < 3; c++)
+                plte.push_back(uint8_t(color >> (8 * c)));
+            trns.push_back(uint8_t(color >> 24));
+        }
+
+        // trailing opaque entries can be left out of the alphas
+        while (!trns.empty() && trns.back() == 255)
+            trns.pop_back();
+
+        AppendChunk("PLTE", plte.data(), plte.size(), bytes);
+        if (!trns.empty())
+            AppendChunk("tRNS", trns.data(), trns.size(), bytes);
+    }
+
+    AppendChunk("IDAT", stream.data(), stream.size(), bytes);
+    AppendChunk("IEND", nullptr, 0, bytes);
+}
+
+/**
+ * Makes the palette of an image, if it has 256 colors or fewer.
+ *
+ * @param rgba RGBA pixels.
+ * @param num_pixels Number of pixels.
+ * @param palette Palette of colors, as little endian RGBA words.
+ * @param indexes Palette index of each pixel.
+ * @return True if the image fits in a palette.
+ */
+bool PngWriter::MakePalette(const uint8_t * rgba, const size_t num_pixels,
+        std::vector<uint32_t> & palette, std::vector<uint8_t> & indexes) {
+
+    std::unordered_map<uint32_t, uint8_t> color_indexes;
+    indexes.resize(num_pixels);
+
+    uint32_t prev_color = 0;
+    uint8_t prev_index = 0;
+
+    for (size_t i = 0; i < num_pixels; i++) {
+
+        uint32_t color;
+        memcpy(&color, rgba + 4 * i, 4);
+
+        // every fully transparent pixel gets the same color
+        if ((color >> 24) == 0)
+            color = 0;
+
+        // consecutive pixels often have the same color
+        if (i > 0 && color == prev_color) {
+            indexes[i] = prev_index;
+            continue;
+        }
+
+        auto it = color_indexes.find(color);
+        if (it == color_indexes.end()) {
+            if (palette.size() == 256)
+                return false;
+            it = color_indexes.emplace(color, uint8_t(palette.size())).first;
+            palette.push_back(color);
+        }
+
+        indexes[i] = prev_index = it->second;
+        prev_color = color;
+    }
+
+    return true;
+}
+
+/**
+ * Filters one row.
+ *
+ * @param filter Filter strategy, other than kFilterAuto.
+ * @param row Row bytes.
+ * @param prev_row Previous row bytes, all 0 for the first row.
+ * @param row_bytes Number of bytes per row.
+ * @param bpp Number of bytes per pixel, rounded up to 1.
+ * @param out Output, of row_bytes + 1 bytes, starting with the filter type.
+ */
+void PngWriter::FilterRow(const Filter filter, const uint8_t * row,
+        const uint8_t * prev_row, const size_t row_bytes, const size_t bpp,
+        uint8_t * out) {
+
+    auto filter_byte = [&](const int type, const size_t i) -> uint8_t {
+        const int a = (i >= bpp) ? row[i - bpp] : 0;
+        const int b = prev_row[i];
+        const int c = (i >= bpp) ? prev_row[i - bpp] : 0;
+        switch (type) {
+            case 1:
+                return uint8_t(row[i] - a);
+            case 2:
+                return uint8_t(row[i] - b);
+            case 3:
+                return uint8_t(row[i] - (a + b) / 2);
+            case 4: {
+                const int p = a + b - c;
+                const int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+                const int pred = (pa <= pb && pa <= pc) ? a
+                    : (pb <= pc) ? b : c;
+                return uint8_t(row[i] - pred);
+            }
+            default:
+                return row[i];
+        }
+    };
+
+    int type = 0;
+
+    switch (filter) {
+        case kFilterSub:
+            type = 1;
+            break;
+        case kFilterUp:
+            type = 2;
+            break;
+        case kFilterAverage:
+            type = 3;
+            break;
+        case kFilterPaeth:
+            type = 4;
+            break;
+        case kFilterAdaptive: {
+            // picks the filter with the minimum sum of absolute differences
+            long best_sum = -1;
+            for (int t = 0; t <= 4; t++) {
+                long sum = 0;
+                for (size_t i = 0; i < row_bytes; i++)
+                    sum += abs(int(int8_t(filter_byte(t, i))));
+                if (best_sum < 0 || sum < best_sum) {
+                    best_sum = sum;
+                    type = t;
+                }
+            }
+            break;
+        }
+        default:
+            break;
+    }
+
+    out[0] = uint8_t(type);
+    for (size_t i = 0; i < row_bytes; i++)
+        out[i + 1] = filter_byte(type, i);
+}
+
+/**
+ * Compresses filtered rows into a zlib stream. Chunks of rows are
+ * deflated in parallel as independent blocks, which are byte aligned
+ * thanks to sync flushes and can be concatenated.
+ *
+ * @param filtered Filtered rows.
+ * @param row_bytes Number of bytes per row, without the filter type.
+ * @param height Number of rows.
+ * @param options Encoding options.
+ * @param stream Output zlib stream.
+ */
+void PngWriter::Compress(const std::vector<uint8_t> & filtered,
+        const size_t row_bytes, const int height, const Options & options,
+        std::vector<uint8_t> & stream) {
+
+    const int level = std::clamp(options.level, 0, 9);
+    const int num_chunks = std::max(1, std::min(options.num_threads,
+                height / kMinChunkRows_));
+    const size_t chunk_rows = (size_t(height) + num_chunks - 1) / num_chunks;
+
+    std::vector<std::vector<uint8_t>> chunks(num_chunks);
+    std::vector<uLong> adlers(num_chunks);
+    std::vector<size_t> sizes(num_chunks);
+
+    auto compress_chunk = [&](const int i) {
+
+        const size_t begin = std::min(filtered.size(),
+                i * chunk_rows * (row_bytes + 1));
+        const size_t end = std::min(filtered.size(),
+                (i + 1) * chunk_rows * (row_bytes + 1));
+        const bool is_last = (i == num_chunks - 1);
+
+        z_stream zs;
+        memset(&zs, 0, sizeof(zs));
+        deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+
+        auto & chunk = chunks[i];
+        chunk.resize(deflateBound(&zs, end - begin) + 16);
+
+        zs.next_in = const_cast<Bytef *>(filtered.data() + begin);
+        zs.avail_in = uInt(end - begin);
+        zs.next_out = chunk.data();
+        zs.avail_out = uInt(chunk.size());
+        deflate(&zs, is_last ? Z_FINISH : Z_SYNC_FLUSH);
+
+        chunk.resize(chunk.size() - zs.avail_out);
+        deflateEnd(&zs);
+
+        adlers[i] = adler32(adler32(0, nullptr, 0), filtered.data() + begin,
+                uInt(end - begin));
+        sizes[i] = end - begin;
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < num_chunks; i++)
+        threads.emplace_back(compress_chunk, i);
+    compress_chunk(0);
+    for (auto & thread : threads)
+        thread.join();
+
+    // zlib header, with the compression level hint
+    const uint8_t cmf = 0x78;
+    uint8_t flg = uint8_t(((level <= 1) ? 0 : (level <= 5) ? 1
+                : (level == 6) ? 2 : 3) << 6);
+    flg |= uint8_t((31 - (cmf * 256 + flg) % 31) % 31);
+    stream.assign({cmf, flg});
+
+    uLong adler = adlers[0];
+    for (int i = 0; i < num_chunks; i++) {
+        stream.insert(stream.end(), chunks[i].begin(), chunks[i].end());
+        if (i > 0)
+            adler = adler32_combine(adler, adlers[i], z_off_t(sizes[i]));
+    }
+
+    for (int i = 3; i >= 0; i--)
+        stream.push_back(uint8_t(adler >> (8 * i)));
+}
+
+/**
+ * Appends a PNG chunk.
+ *
+ * @param type Chunk type, of 4 characters.
+ * @param data Chunk data.
+ * @param size Chunk data size.
+ * @param bytes PNG file bytes to append the chunk to.
+ */
+void PngWriter::AppendChunk(const char * type, const uint8_t * data,
+        const size_t size, std::vector<uint8_t> & bytes) {
+
+    for (int i = 3; i >= 0; i--)
+        bytes.push_back(uint8_t(size >> (8 * i)));
+
+    const size_t start = bytes.size();
+    bytes.insert(bytes.end(), type, type + 4);
+    if (size > 0)
+        bytes.insert(bytes.end(), data, data + size);
+
+    const uLong crc = crc32(0, bytes.data() + start, uInt(size + 4));
+    for (int i = 3; i >= 0; i--)
+        bytes.push_back(uint8_t(crc >> (8 * i)));
+}
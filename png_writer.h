@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+
+/**
+ * PNG encoder for RGBA framebuffers, tuned for chart images.
+ *
+ * Images with 256 colors or fewer are written as indexed (palette) PNG,
+ * with the smallest bit depth that fits them, and the rest as RGBA PNG.
+ * Rows are compressed in chunks, in parallel, and the chunks are joined
+ * in a single standard zlib stream.
+ */
+class PngWriter {
+public:
+    /// Row filter strategies enumeration.
+    enum Filter {
+        kFilterAuto, ///< None for indexed images, adaptive for the rest.
+        kFilterNone, kFilterSub, kFilterUp, kFilterAverage, kFilterPaeth,
+        kFilterAdaptive ///< Best filter of each row, by a size heuristic.
+    };
+
+    /// PNG encoding options data structure.
+    struct Options {
+        Filter filter = kFilterAuto; ///< Row filter strategy.
+        int level = 6; ///< Deflate compression level (0-9).
+        int num_threads = 1; ///< Number of compression threads.
+        bool allow_palette = true; ///< Whether indexed PNG can be written.
+    };
+
+    // public functions
+    static void Encode(const uint8_t * rgba, const int width,
+            const int height, const Options & options,
+            std::vector<uint8_t> & bytes);
+
+private:
+    static const int kMinChunkRows_;
+
+    // helper functions
+    static bool MakePalette(const uint8_t * rgba, const size_t num_pixels,
+            std::vector<uint32_t> & palette, std::vector<uint8_t> & indexes);
+    static void FilterRow(const Filter filter, const uint8_t * row,
+            const uint8_t * prev_row, const size_t row_bytes,
+            const size_t bpp, uint8_t * out);
+    static void Compress(const std::vector<uint8_t> & filtered,
+            const size_t row_bytes, const int height, const Options & options,
+            std::vector<uint8_t> & stream);
+    static void AppendChunk(const char * type, const uint8_t * data,
+            const size_t size, std::vector<uint8_t> & bytes);
+};
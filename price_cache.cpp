@@ -0,0 +1,504 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "price_cache.h"
+
+
+/// Magic bytes at the start of every cache file.
+const char PriceCache::kMagic_[8] = {'B', 'T', 'C', 'C', 'A', 'C', 'H', 'E'};
+
+/// Cache file format version, to be increased whenever the format changes.
+const uint32_t PriceCache::kVersion_ = 6;
+
+/// Number of bytes hashed at the start and at the end of the source file.
+const size_t PriceCache::kHashedBytes_ = 64 * 1024;
+
+namespace {
+
+/// FNV-1a hash offset basis.
+const uint64_t kFnvOffsetBasis = 14695981039346656037ull;
+
+/**
+ * Extends a FNV-1a hash with some bytes.
+ *
+ * @param hash Hash of the previous bytes.
+ * @param bytes Pointer to the first byte.
+ * @param size Number of bytes.
+ * @return Hash including the bytes.
+ */
+uint64_t Fnv1a(uint64_t hash, const char * bytes, const size_t size) {
+
+    for (size_t i = 0; i < size; i++) {
+        hash ^= uint8_t(bytes[i]);
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+}
+
+/**
+ * Constructor.
+ * Maps the cache file and checks that it was built from the source file
+ * identified by the stamp.
+ *
+ * @param path Cache file path.
+ * @param stamp Stamp of the current source file.
+ */
+PriceCache::PriceCache(const std::string & path, const Stamp & stamp)
+    : file_(path) {
+
+    const std::string_view contents = file_.View();
+    if (contents.size() < sizeof(Header))
+        return;
+
+    Header header;
+    memcpy(&header, contents.data(), sizeof(Header));
+
+    const size_t rows_per_record = header.rows_per_record;
+    const size_t num_records = (rows_per_record == 0) ? 0
+        : (header.num_rows + rows_per_record - 1) / rows_per_record;
+
+    is_valid_ = (memcmp(header.magic, kMagic_, sizeof(kMagic_)) == 0
+            && header.version == kVersion_
+            && header.source_size == stamp.size
+            && header.source_mtime_ns == stamp.mtime_ns
+            && header.source_hash == stamp.hash
+            && header.names_bytes % sizeof(uint64_t) == 0
+            && rows_per_record > 0 && rows_per_record % 64 == 0
+            && contents.size() == sizeof(Header) + header.names_bytes
+                + num_records * RecordBytes(header.num_exchanges,
+                    rows_per_record));
+
+    if (is_valid_) {
+        size_ = header.num_rows;
+        num_exchanges_ = header.num_exchanges;
+        names_bytes_ = header.names_bytes;
+        rows_per_record_ = rows_per_record;
+        names_ = contents.substr(sizeof(Header), header.names_bytes);
+        names_ = names_.substr(0, names_.find('\0'));
+    }
+}
+
+/**
+ * Checks whether the cache could be read and matches its source file.
+ *
+ * @return True if the cache can be used.
+ */
+bool PriceCache::IsValid() const {
+
+    return is_valid_;
+}
+
+/**
+ * Gets number of rows in the cache.
+ *
+ * @return Number of rows.
+ */
+size_t PriceCache::Size() const {
+
+    return size_;
+}
+
+/**
+ * Gets number of rows of every record but the last one, which can have
+ * fewer.
+ *
+ * @return Rows per record.
+ */
+size_t PriceCache::RowsPerRecord() const {
+
+    return rows_per_record_;
+}
+
+/**
+ * Gets number of records in the cache.
+ *
+ * @return Number of records.
+ */
+size_t PriceCache::NumRecords() const {
+
+    return is_valid_ ? (size_ + rows_per_record_ - 1) / rows_per_record_ : 0;
+}
+
+/**
+ * Gets number of rows of a record.
+ *
+ * @param r Record position, less than NumRecords().
+ * @return Number of rows.
+ */
+size_t PriceCache::RecordSize(const size_t r) const {
+
+    return std::min(rows_per_record_, size_ - r * rows_per_record_);
+}
+
+/**
+ * Gets packed validity bitmap words of a record.
+ *
+ * @param r Record position, less than NumRecords().
+ * @return Pointer to the first of Bitmap::NumWordsFor(RecordSize(r))
+ * words.
+ */
+const uint64_t * PriceCache::Validity(const size_t r) const {
+
+    return reinterpret_cast<const uint64_t *>(RecordData(r));
+}
+
+/**
+ * Gets times array of a record, in seconds since 1970-01-01 00:00:00 UTC.
+ *
+ * @param r Record position, less than NumRecords().
+ * @return Pointer to the first of RecordSize(r) times.
+ */
+const int64_t * PriceCache::Times(const size_t r) const {
+
+    return reinterpret_cast<const int64_t *>(Validity(r)
+            + (num_exchanges_ + 1) * (rows_per_record_ / 64));
+}
+
+/**
+ * Gets prices array of a record.
+ *
+ * @param r Record position, less than NumRecords().
+ * @return Pointer to the first of RecordSize(r) prices.
+ */
+const float * PriceCache::Prices(const size_t r) const {
+
+    return reinterpret_cast<const float *>(Times(r) + rows_per_record_);
+}
+
+/**
+ * Gets names of the exchanges, in the order of their columns.
+ *
+ * @return Exchange names.
+ */
+std::vector<std::string> PriceCache::ExchangeNames() const {
+
+    std::vector<std::string> names;
+    std::string_view names_left = names_;
+
+    for (size_t k = 0; k < num_exchanges_; k++) {
+        const size_t eol = std::min(names_left.find('\n'), names_left.size());
+        names.emplace_back(names_left.substr(0, eol));
+        names_left.remove_prefix(std::min(eol + 1, names_left.size()));
+    }
+
+    return names;
+}
+
+/**
+ * Gets packed validity bitmap words of the prices of an exchange in a
+ * record.
+ *
+ * @param r Record position, less than NumRecords().
+ * @param k Exchange position, less than the number of exchange names.
+ * @return Pointer to the first of Bitmap::NumWordsFor(RecordSize(r))
+ * words.
+ */
+const uint64_t * PriceCache::ExchangeValidity(const size_t r,
+        const size_t k) const {
+
+    return Validity(r) + (k + 1) * (rows_per_record_ / 64);
+}
+
+/**
+ * Gets prices array of an exchange in a record.
+ *
+ * @param r Record position, less than NumRecords().
+ * @param k Exchange position, less than the number of exchange names.
+ * @return Pointer to the first of RecordSize(r) prices.
+ */
+const float * PriceCache::ExchangePrices(const size_t r, const size_t k)
+    const {
+
+    return Prices(r) + (k + 1) * rows_per_record_;
+}
+
+/**
+ * Gets the stamp of a source file from its size, modification time and a
+ * hash of its first and last bytes. Hashing only both ends keeps this
+ * cheap for big files, while still catching appended or rewritten rows.
+ *
+ * @param path Source file path.
+ * @param stamp Stamp to fill.
+ * @return True if the file could be read.
+ */
+bool PriceCache::StampFile(const std::string & path, Stamp & stamp) {
+
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    bool ok = (fstat(fd, &st) == 0);
+
+    if (ok) {
+
+        stamp.size = uint64_t(st.st_size);
+        stamp.mtime_ns = int64_t(st.st_mtim.tv_sec) * 1000000000
+            + st.st_mtim.tv_nsec;
+        stamp.inode = uint64_t(st.st_ino);
+
+        // FNV-1a hash of the first and last bytes of the file
+        std::vector<char> buffer(kHashedBytes_);
+        uint64_t hash = kFnvOffsetBasis;
+
+        const off_t offsets[] = {0, std::max(off_t(0),
+                off_t(stamp.size) - off_t(kHashedBytes_))};
+
+        stamp.ends_with_newline = true;
+
+        for (const off_t offset : offsets) {
+            const ssize_t n = pread(fd, buffer.data(), buffer.size(), offset);
+            if (n < 0) {
+                ok = false;
+                break;
+            }
+            hash = Fnv1a(hash, buffer.data(), size_t(n));
+            if (n > 0)
+                stamp.ends_with_newline = (buffer[n - 1] == '\n');
+        }
+
+        stamp.hash = hash;
+    }
+
+    close(fd);
+
+    return ok;
+}
+
+/**
+ * Hashes the first and last bytes of some bytes, like StampFile() does
+ * with a whole file, so the hash of the contents of a file is the hash of
+ * its stamp.
+ *
+ * @param bytes View of the bytes, such as the start of a file.
+ * @return Hash of the first and last bytes.
+ */
+uint64_t PriceCache::HashEnds(std::string_view bytes) {
+
+    const size_t n = std::min(bytes.size(), kHashedBytes_);
+
+    uint64_t hash = Fnv1a(kFnvOffsetBasis, bytes.data(), n);
+    hash = Fnv1a(hash, bytes.data() + bytes.size() - n, n);
+
+    return hash;
+}
+
+/**
+ * Writes a cache file. It is written to a temporary file first and then
+ * renamed, so concurrent readers never see a partial cache.
+ *
+ * @param path Cache file path.
+ * @param stamp Stamp of the source file the data was parsed from.
+ * @param exchanges Names of the exchanges.
+ * @param rows_per_record Rows of every record, a multiple of 64.
+ * @param records Records of data, all of rows_per_record rows but the
+ * last one, which can have fewer.
+ * @return True if the cache file could be written.
+ */
+bool PriceCache::Write(const std::string & path, const Stamp & stamp,
+        const std::vector<std::string> & exchanges,
+        const size_t rows_per_record, const std::vector<Record> & records) {
+
+    const std::string names = MakeNames(exchanges);
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kMagic_, sizeof(kMagic_));
+    header.version = kVersion_;
+    header.num_rows = 0;
+    for (const Record & record : records)
+        header.num_rows += uint32_t(record.size);
+    header.source_size = stamp.size;
+    header.source_mtime_ns = stamp.mtime_ns;
+    header.source_hash = stamp.hash;
+    header.num_exchanges = uint32_t(exchanges.size());
+    header.names_bytes = uint32_t(names.size());
+    header.rows_per_record = uint32_t(rows_per_record);
+
+    const std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+
+    FILE * file = fopen(tmp_path.c_str(), "wb");
+    if (!file)
+        return false;
+
+    bool ok = (fwrite(&header, sizeof(header), 1, file) == 1
+            && fwrite(names.data(), 1, names.size(), file) == names.size());
+
+    std::vector<char> bytes;
+
+    for (size_t r = 0; ok && r < records.size(); r++) {
+        PackRecord(records[r], rows_per_record, bytes);
+        ok = (fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size());
+    }
+
+    ok = (fclose(file) == 0) && ok;
+    ok = ok && (rename(tmp_path.c_str(), path.c_str()) == 0);
+
+    if (!ok)
+        remove(tmp_path.c_str());
+
+    return ok;
+}
+
+/**
+ * Appends rows to a cache file in place, when it is the cache of the
+ * previous version of a source file that has only had rows appended. The
+ * last record of the cache is rewritten with its rows and the first new
+ * ones, the remaining new rows are written in new records, and the header
+ * is rewritten last, so readers only take the new rows once they are all
+ * there. The bytes of the rows already in the cache are written again
+ * with the same values, so readers copying them meanwhile get them right.
+ *
+ * @param path Cache file path.
+ * @param prev_stamp Stamp of the previous version of the source file,
+ * which the cache file must have been written for.
+ * @param prev_size Number of rows in the cache file.
+ * @param stamp Stamp of the current source file.
+ * @param num_exchanges Number of exchanges, as in the cache file.
+ * @param rows_per_record Rows of every record, as in the cache file.
+ * @param records Records of data from record prev_size / rows_per_record
+ * to the end, all of rows_per_record rows but the last one, which can have
+ * fewer.
+ * @return True if the rows could be appended, false if the cache file
+ * could not be written or does not match, and has to be written again.
+ */
+bool PriceCache::Append(const std::string & path, const Stamp & prev_stamp,
+        const size_t prev_size, const Stamp & stamp,
+        const size_t num_exchanges, const size_t rows_per_record,
+        const std::vector<Record> & records) {
+
+    const int fd = open(path.c_str(), O_RDWR);
+    if (fd < 0)
+        return false;
+
+    Header header;
+    struct stat st;
+    const size_t record_bytes = RecordBytes(num_exchanges, rows_per_record);
+
+    bool ok = (pread(fd, &header, sizeof(header), 0) == sizeof(header)
+            && fstat(fd, &st) == 0
+            && memcmp(header.magic, kMagic_, sizeof(kMagic_)) == 0
+            && header.version == kVersion_
+            && header.source_size == prev_stamp.size
+            && header.source_mtime_ns == prev_stamp.mtime_ns
+            && header.source_hash == prev_stamp.hash
+            && header.num_rows == prev_size
+            && header.num_exchanges == num_exchanges
+            && header.rows_per_record == rows_per_record
+            && size_t(st.st_size) == sizeof(Header) + header.names_bytes
+                + (prev_size + rows_per_record - 1) / rows_per_record
+                    * record_bytes);
+
+    const size_t first_record = prev_size / rows_per_record;
+    size_t size = first_record * rows_per_record;
+    std::vector<char> bytes;
+
+    for (size_t r = 0; ok && r < records.size(); r++) {
+        PackRecord(records[r], rows_per_record, bytes);
+        const off_t offset = off_t(sizeof(Header) + header.names_bytes
+                + (first_record + r) * record_bytes);
+        ok = (pwrite(fd, bytes.data(), bytes.size(), offset)
+                == ssize_t(bytes.size()));
+        size += records[r].size;
+    }
+
+    if (ok) {
+        header.num_rows = uint32_t(size);
+        header.source_size = stamp.size;
+        header.source_mtime_ns = stamp.mtime_ns;
+        header.source_hash = stamp.hash;
+        ok = (pwrite(fd, &header, sizeof(header), 0) == sizeof(header));
+    }
+
+    ok = (close(fd) == 0) && ok;
+
+    return ok;
+}
+
+/**
+ * Gets the data of a record in the mapped cache file.
+ *
+ * @param r Record position, less than NumRecords().
+ * @return Pointer to the first byte of the record.
+ */
+const char * PriceCache::RecordData(const size_t r) const {
+
+    return file_.View().data() + sizeof(Header) + names_bytes_
+        + r * RecordBytes(num_exchanges_, rows_per_record_);
+}
+
+/**
+ * Gets size in bytes of every record, including the padding of the last
+ * one.
+ *
+ * @param num_exchanges Number of exchanges.
+ * @param rows_per_record Rows per record, a multiple of 64.
+ * @return Bytes per record.
+ */
+size_t PriceCache::RecordBytes(const size_t num_exchanges,
+        const size_t rows_per_record) {
+
+    const size_t num_columns = num_exchanges + 1;
+
+    return num_columns * (rows_per_record / 64) * sizeof(uint64_t)
+        + rows_per_record * (sizeof(int64_t) + num_columns * sizeof(float));
+}
+
+/**
+ * Makes the names of the exchanges as stored in the cache file, one per
+ * line, padded with null bytes to keep the records aligned.
+ *
+ * @param exchanges Names of the exchanges.
+ * @return Names bytes.
+ */
+std::string PriceCache::MakeNames(
+        const std::vector<std::string> & exchanges) {
+
+    std::string names;
+    for (const std::string & exchange : exchanges)
+        names += exchange + '\n';
+    names.resize((names.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t)
+            * sizeof(uint64_t), '\0');
+
+    return names;
+}
+
+/**
+ * Packs a record into the bytes of the cache file, padded with zeros up to
+ * its full size.
+ *
+ * @param record Record of data, of up to rows_per_record rows.
+ * @param rows_per_record Rows per record, a multiple of 64.
+ * @param bytes Packed record.
+ */
+void PriceCache::PackRecord(const Record & record,
+        const size_t rows_per_record, std::vector<char> & bytes) {
+
+    const size_t num_exchanges = record.exchange_prices.size();
+    const size_t valid_bytes = Bitmap::NumWordsFor(record.size)
+        * sizeof(uint64_t);
+    const size_t bitmap_bytes = rows_per_record / 64 * sizeof(uint64_t);
+
+    bytes.assign(RecordBytes(num_exchanges, rows_per_record), '\0');
+    char * p = bytes.data();
+
+    memcpy(p, record.valid, valid_bytes);
+    for (size_t k = 0; k < num_exchanges; k++)
+        memcpy(p + (k + 1) * bitmap_bytes, record.exchange_valid[k],
+                valid_bytes);
+    p += (num_exchanges + 1) * bitmap_bytes;
+
+    memcpy(p, record.times, record.size * sizeof(int64_t));
+    p += rows_per_record * sizeof(int64_t);
+
+    memcpy(p, record.prices, record.size * sizeof(float));
+    for (size_t k = 0; k < num_exchanges; k++)
+        memcpy(p + (k + 1) * rows_per_record * sizeof(float),
+                record.exchange_prices[k], record.size * sizeof(float));
+}
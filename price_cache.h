@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "bitmap.h"
+#include "mapped_file.h"
+
+
+/**
+ * Binary columnar cache file of parsed Bitcoin price data.
+ *
+ * The file has a versioned header describing the source CSV file it was
+ * built from, followed by the names of the exchanges and by records of a
+ * fixed number of rows. Each record holds packed validity bitmaps and
+ * contiguous arrays of times (epoch seconds), averaged prices and prices
+ * of every exchange, and the last one is padded to full size. Rows
+ * appended to the source file are appended to the cache by rewriting its
+ * last record and its header only, without changing the bytes of the rows
+ * already there. It is memory-mapped when read, so no parsing is needed.
+ */
+class PriceCache {
+public:
+    /// Identification of the source file a cache was built from.
+    struct Stamp {
+        uint64_t size = 0; ///< Source file size in bytes.
+        int64_t mtime_ns = 0; ///< Source file modification time.
+        uint64_t hash = 0; ///< Hash of the first and last source bytes.
+        uint64_t inode = 0; ///< Source file inode number.
+        bool ends_with_newline = true; ///< Whether the last line is complete.
+    };
+
+    /// Columns of the rows of one record data structure, as views of
+    /// arrays of data.
+    struct Record {
+        size_t size = 0; ///< Number of rows.
+        const int64_t * times = nullptr; ///< Times of the rows.
+        const float * prices = nullptr; ///< Averaged prices of the rows.
+        const uint64_t * valid = nullptr; ///< Validity bitmap words.
+        /// Prices of every exchange.
+        std::vector<const float *> exchange_prices;
+        /// Validity bitmap words of the prices of every exchange.
+        std::vector<const uint64_t *> exchange_valid;
+    };
+
+    // constructor
+    PriceCache(const std::string & path, const Stamp & stamp);
+
+    // public functions
+    bool IsValid() const;
+    size_t Size() const;
+    size_t RowsPerRecord() const;
+    size_t NumRecords() const;
+    size_t RecordSize(const size_t r) const;
+    const uint64_t * Validity(const size_t r) const;
+    const int64_t * Times(const size_t r) const;
+    const float * Prices(const size_t r) const;
+    std::vector<std::string> ExchangeNames() const;
+    const uint64_t * ExchangeValidity(const size_t r, const size_t k) const;
+    const float * ExchangePrices(const size_t r, const size_t k) const;
+
+    static bool StampFile(const std::string & path, Stamp & stamp);
+    static uint64_t HashEnds(std::string_view bytes);
+    static bool Write(const std::string & path, const Stamp & stamp,
+            const std::vector<std::string> & exchanges,
+            const size_t rows_per_record,
+            const std::vector<Record> & records);
+    static bool Append(const std::string & path, const Stamp & prev_stamp,
+            const size_t prev_size, const Stamp & stamp,
+            const size_t num_exchanges, const size_t rows_per_record,
+            const std::vector<Record> & records);
+
+private:
+    /// Cache file header data structure.
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t num_rows;
+        uint64_t source_size;
+        int64_t source_mtime_ns;
+        uint64_t source_hash;
+        uint32_t num_exchanges;
+        uint32_t names_bytes; // padded to a multiple of 8
+        uint32_t rows_per_record; // multiple of 64
+        uint32_t padding;
+    };
+
+    static const char kMagic_[8];
+    static const uint32_t kVersion_;
+    static const size_t kHashedBytes_;
+
+    MappedFile file_; ///< Mapped cache file.
+    size_t size_ = 0; ///< Number of rows, or 0 if the cache is not valid.
+    size_t num_exchanges_ = 0; ///< Number of exchange columns.
+    size_t names_bytes_ = 0; ///< Bytes of exchange names, with padding.
+    size_t rows_per_record_ = 0; ///< Rows of every record.
+    std::string_view names_; ///< Exchange names, one per line.
+    bool is_valid_ = false; ///< Whether the cache matches its source.
+
+    // helper functions
+    const char * RecordData(const size_t r) const;
+    static size_t RecordBytes(const size_t num_exchanges,
+            const size_t rows_per_record);
+    static std::string MakeNames(const std::vector<std::string> & exchanges);
+    static void PackRecord(const Record & record,
+            const size_t rows_per_record, std::vector<char> & bytes);
+};
@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <limits>
+#include "range_index.h"
+
+
+/**
+ * Builds the index from a column of values.
+ *
+ * @param values Pointer to the first value of the column, where values
+ * without data must be 0.
+ * @param valid Whether each value has data.
+ * @param size Number of values in the column.
+ */
+void RangeIndex::Build(const float * values, const Bitmap & valid,
+        const size_t size) {
+
+    const float inf = std::numeric_limits<float>::infinity();
+
+    sums_.assign(size + 1, 0.0);
+    counts_.assign(size + 1, 0);
+
+    mins_.assign(1, std::vector<float>(size));
+    maxs_.assign(1, std::vector<float>(size));
+
+    for (size_t i = 0; i < size; i++) {
+
+        const bool is_valid = valid.Test(i);
+
+        sums_[i + 1] = sums_[i] + values[i];
+        counts_[i + 1] = counts_[i] + is_valid;
+
+        mins_[0][i] = is_valid ? values[i] : inf;
+        maxs_[0][i] = is_valid ? values[i] : -inf;
+    }
+
+    // each level combines two overlapping ranges of the level below
+    for (size_t len = 2; len <= size; len *= 2) {
+
+        const auto & prev_mins = mins_.back();
+        const auto & prev_maxs = maxs_.back();
+        std::vector<float> level_mins(size - len + 1);
+        std::vector<float> level_maxs(size - len + 1);
+
+        for (size_t i = 0; i + len <= size; i++) {
+            level_mins[i] = std::min(prev_mins[i], prev_mins[i + len / 2]);
+            level_maxs[i] = std::max(prev_maxs[i], prev_maxs[i + len / 2]);
+        }
+
+        mins_.push_back(std::move(level_mins));
+        maxs_.push_back(std::move(level_maxs));
+    }
+}
+
+/**
+ * Extends the index with a value appended to the column, in logarithmic
+ * time.
+ *
+ * @param value Appended value, 0 if it has no data.
+ * @param is_valid Whether the value has data.
+ */
+void RangeIndex::Append(const float value, const bool is_valid) {
+
+    const float inf = std::numeric_limits<float>::infinity();
+
+    if (sums_.empty())
+        Build(nullptr, Bitmap(), 0);
+
+    sums_.push_back(sums_.back() + value);
+    counts_.push_back(counts_.back() + is_valid);
+
+    mins_[0].push_back(is_valid ? value : inf);
+    maxs_[0].push_back(is_valid ? value : -inf);
+
+    // each level gets the new range of 2^k positions ending at the value
+    const size_t size = Size();
+
+    for (size_t k = 1; (size_t(1) << k) <= size; k++) {
+
+        const size_t len = size_t(1) << k;
+        if (k == mins_.size()) {
+            mins_.emplace_back();
+            maxs_.emplace_back();
+        }
+
+        const size_t i = size - len;
+        mins_[k].push_back(std::min(mins_[k - 1][i],
+                    mins_[k - 1][i + len / 2]));
+        maxs_[k].push_back(std::max(maxs_[k - 1][i],
+                    maxs_[k - 1][i + len / 2]));
+    }
+}
+
+/**
+ * Gets number of positions in the indexed column.
+ *
+ * @return Number of positions.
+ */
+size_t RangeIndex::Size() const {
+
+    return counts_.empty() ? 0 : counts_.size() - 1;
+}
+
+/**
+ * Gets number of valid values in the range [a, b).
+ *
+ * @param a,b First and one past last positions of the range.
+ * @return Number of valid values.
+ */
+size_t RangeIndex::Count(const size_t a, const size_t b) const {
+
+    return ((a >= b) ? 0 : counts_[b] - counts_[a]);
+}
+
+/**
+ * Gets sum of valid values in the range [a, b).
+ *
+ * @param a,b First and one past last positions of the range.
+ * @return Sum of valid values.
+ */
+double RangeIndex::Sum(const size_t a, const size_t b) const {
+
+    return ((a >= b) ? 0.0 : sums_[b] - sums_[a]);
+}
+
+/**
+ * Gets average of valid values in the range [a, b) or -1 if there are no
+ * valid values in it.
+ *
+ * @param a,b First and one past last positions of the range.
+ * @return Average or -1.
+ */
+float RangeIndex::Avg(const size_t a, const size_t b) const {
+
+    const size_t count = Count(a, b);
+
+    return ((count == 0) ? -1.0f : float(Sum(a, b) / count));
+}
+
+/**
+ * Gets minimum of valid values in the range [a, b) or -1 if there are no
+ * valid values in it.
+ *
+ * @param a,b First and one past last positions of the range.
+ * @return Minimum or -1.
+ */
+float RangeIndex::Min(const size_t a, const size_t b) const {
+
+    if (Count(a, b) == 0)
+        return -1.0f;
+
+    const int k = FloorLog2(b - a);
+
+    return std::min(mins_[k][a], mins_[k][b - (size_t(1) << k)]);
+}
+
+/**
+ * Gets maximum of valid values in the range [a, b) or -1 if there are no
+ * valid values in it.
+ *
+ * @param a,b First and one past last positions of the range.
+ * @return Maximum or -1.
+ */
+float RangeIndex::Max(const size_t a, const size_t b) const {
+
+    if (Count(a, b) == 0)
+        return -1.0f;
+
+    const int k = FloorLog2(b - a);
+
+    return std::max(maxs_[k][a], maxs_[k][b - (size_t(1) << k)]);
+}
+
+/**
+ * Gets the floor of the base 2 logarithm of a positive number.
+ *
+ * @param n Positive number.
+ * @return Floor of log2(n).
+ */
+int RangeIndex::FloorLog2(const size_t n) {
+
+    return int(sizeof(unsigned long long) * 8 - 1) - __builtin_clzll(n);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "bitmap.h"
+
+
+/**
+ * Range aggregation index over a column of values.
+ *
+ * Built once from the column, it answers count, sum and average queries
+ * over any range of positions in constant time, from prefix sums, and
+ * minimum and maximum queries also in constant time, from sparse tables.
+ * Values without data, as marked by a validity bitmap, are ignored.
+ */
+class RangeIndex {
+public:
+    // public functions
+    void Build(const float * values, const Bitmap & valid,
+            const size_t size);
+    void Append(const float value, const bool is_valid);
+
+    size_t Size() const;
+    size_t Count(const size_t a, const size_t b) const;
+    double Sum(const size_t a, const size_t b) const;
+    float Avg(const size_t a, const size_t b) const;
+    float Min(const size_t a, const size_t b) const;
+    float Max(const size_t a, const size_t b) const;
+
+private:
+    /// Prefix sums of values, where sums_[i] is the sum of the first i.
+    std::vector<double> sums_;
+    /// Prefix counts of valid values, where counts_[i] counts the first i.
+    std::vector<size_t> counts_;
+    /// Sparse tables, where level k holds the minimum or maximum of every
+    /// range of 2^k positions starting at each position.
+    std::vector<std::vector<float>> mins_, maxs_;
+
+    // helper functions
+    static int FloorLog2(const size_t n);
+};
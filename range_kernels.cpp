@@ -0,0 +1,713 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "range_kernels.h"
+
+
+namespace kernels {
+
+namespace {
+
+/// Partial reduction data structure, merged from every kernel.
+struct Accum {
+    double sum = 0.0;
+    double sum_sq = 0.0;
+    float min = std::numeric_limits<float>::infinity();
+    float max = -std::numeric_limits<float>::infinity();
+};
+
+/// Kernel function type, reducing the range [a, b) into an accumulator,
+/// where a is a multiple of the kernel block size.
+typedef void (*Kernel)(const float *, const uint64_t *, size_t, size_t,
+        Accum &);
+
+/// Row-wise kernel function type, reducing the rows [a, b) of several
+/// columns into the outputs of the rows from first, where a is a multiple
+/// of the kernel block size.
+typedef void (*RowKernel)(const float * const *, const uint64_t * const *,
+        size_t, size_t, size_t, size_t, float *, float *, float *);
+
+/// Batch transform kernel function type, transforming values in place.
+typedef void (*TransformKernel)(float *, size_t);
+
+/**
+ * Gets the validity bit of a position.
+ */
+inline bool IsValid(const uint64_t * valid, const size_t i) {
+
+    return (valid[i / 64] >> (i % 64)) & 1;
+}
+
+/**
+ * Scalar kernel, also used for the unaligned ends of every range.
+ */
+void ScalarKernel(const float * values, const uint64_t * valid,
+        size_t a, const size_t b, Accum & accum) {
+
+    for (; a < b; a++) {
+        if (!IsValid(valid, a))
+            continue;
+        const double value = values[a];
+        accum.sum += value;
+        accum.sum_sq += value * value;
+        accum.min = std::min(accum.min, values[a]);
+        accum.max = std::max(accum.max, values[a]);
+    }
+}
+
+/**
+ * Scalar row-wise kernel, also used for the unaligned ends of every range.
+ */
+void ScalarRowKernel(const float * const * columns,
+        const uint64_t * const * valid, const size_t num_columns, size_t a,
+        const size_t b, const size_t first, float * means, float * mins,
+        float * maxs) {
+
+    for (; a < b; a++) {
+
+        float sum = 0.0f, count = 0.0f;
+        float min = std::numeric_limits<float>::infinity();
+        float max = -std::numeric_limits<float>::infinity();
+
+        for (size_t c = 0; c < num_columns; c++) {
+            if (!IsValid(valid[c], a))
+                continue;
+            const float value = columns[c][a];
+            sum += value;
+            count += 1.0f;
+            min = std::min(min, value);
+            max = std::max(max, value);
+        }
+
+        means[a - first] = (count > 0.0f) ? sum / count : -1.0f;
+        mins[a - first] = (count > 0.0f) ? min : -1.0f;
+        maxs[a - first] = (count > 0.0f) ? max : -1.0f;
+    }
+}
+
+/**
+ * Scalar natural logarithm kernel, leaving values not greater than 0 as
+ * they are. Also used for the ends of vectorized batches.
+ */
+void ScalarLogKernel(float * values, const size_t size) {
+
+    for (size_t i = 0; i < size; i++)
+        if (values[i] > 0)
+            values[i] = std::log(values[i]);
+}
+
+// coefficients of the Cephes single precision logarithm, with mantissas
+// reduced to [sqrt(1/2), sqrt(2)) and a 9th degree polynomial, accurate to
+// a couple of float ulps
+const float kLogP[] = {7.0376836292e-2f, -1.1514610310e-1f, 1.1676998740e-1f,
+    -1.2420140846e-1f, 1.4249322787e-1f, -1.6668057665e-1f,
+    2.0000714765e-1f, -2.4999993993e-1f, 3.3333331174e-1f};
+const float kLogQ1 = -2.12194440e-4f;
+const float kLogQ2 = 0.693359375f;
+const float kSqrtHalf = 0.707106781186547524f;
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/**
+ * SSE2 kernel, processing 4 values per step.
+ */
+void Sse2Kernel(const float * values, const uint64_t * valid,
+        size_t a, const size_t b, Accum & accum) {
+
+    const __m128i bits = _mm_setr_epi32(1, 2, 4, 8);
+    const __m128 pos_inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+    const __m128 neg_inf = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+
+    __m128d sum = _mm_setzero_pd(), sum_sq = _mm_setzero_pd();
+    __m128 min = pos_inf, max = neg_inf;
+
+    for (; a + 4 <= b; a += 4) {
+
+        const int nibble = int((valid[a / 64] >> (a % 64)) & 0xF);
+        if (nibble == 0)
+            continue;
+
+        const __m128i lane_bits = _mm_and_si128(_mm_set1_epi32(nibble), bits);
+        const __m128 mask = _mm_castsi128_ps(_mm_cmpeq_epi32(lane_bits, bits));
+        const __m128 v = _mm_and_ps(_mm_loadu_ps(values + a), mask);
+
+        const __m128d lo = _mm_cvtps_pd(v);
+        const __m128d hi = _mm_cvtps_pd(_mm_movehl_ps(v, v));
+        sum = _mm_add_pd(sum, _mm_add_pd(lo, hi));
+        sum_sq = _mm_add_pd(sum_sq,
+                _mm_add_pd(_mm_mul_pd(lo, lo), _mm_mul_pd(hi, hi)));
+
+        min = _mm_min_ps(min, _mm_or_ps(_mm_and_ps(mask, v),
+                    _mm_andnot_ps(mask, pos_inf)));
+        max = _mm_max_ps(max, _mm_or_ps(_mm_and_ps(mask, v),
+                    _mm_andnot_ps(mask, neg_inf)));
+    }
+
+    double sums[2], sums_sq[2];
+    float mins[4], maxs[4];
+    _mm_storeu_pd(sums, sum);
+    _mm_storeu_pd(sums_sq, sum_sq);
+    _mm_storeu_ps(mins, min);
+    _mm_storeu_ps(maxs, max);
+
+    accum.sum += sums[0] + sums[1];
+    accum.sum_sq += sums_sq[0] + sums_sq[1];
+    accum.min = std::min(accum.min, *std::min_element(mins, mins + 4));
+    accum.max = std::max(accum.max, *std::max_element(maxs, maxs + 4));
+
+    ScalarKernel(values, valid, a, b, accum);
+}
+
+/**
+ * AVX2 kernel, processing 8 values per step.
+ */
+__attribute__((target("avx2")))
+void Avx2Kernel(const float * values, const uint64_t * valid,
+        size_t a, const size_t b, Accum & accum) {
+
+    const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m256 pos_inf = _mm256_set1_ps(
+            std::numeric_limits<float>::infinity());
+    const __m256 neg_inf = _mm256_set1_ps(
+            -std::numeric_limits<float>::infinity());
+
+    __m256d sum = _mm256_setzero_pd(), sum_sq = _mm256_setzero_pd();
+    __m256 min = pos_inf, max = neg_inf;
+
+    for (; a + 8 <= b; a += 8) {
+
+        const int byte = int((valid[a / 64] >> (a % 64)) & 0xFF);
+        if (byte == 0)
+            continue;
+
+        const __m256i lane_bits = _mm256_and_si256(_mm256_set1_epi32(byte),
+                bits);
+        const __m256 mask = _mm256_castsi256_ps(
+                _mm256_cmpeq_epi32(lane_bits, bits));
+        const __m256 v = _mm256_and_ps(_mm256_loadu_ps(values + a), mask);
+
+        const __m256d lo = _mm256_cvtps_pd(_mm256_castps256_ps128(v));
+        const __m256d hi = _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1));
+        sum = _mm256_add_pd(sum, _mm256_add_pd(lo, hi));
+        sum_sq = _mm256_add_pd(sum_sq, _mm256_add_pd(_mm256_mul_pd(lo, lo),
+                    _mm256_mul_pd(hi, hi)));
+
+        min = _mm256_min_ps(min, _mm256_blendv_ps(pos_inf, v, mask));
+        max = _mm256_max_ps(max, _mm256_blendv_ps(neg_inf, v, mask));
+    }
+
+    double sums[4], sums_sq[4];
+    float mins[8], maxs[8];
+    _mm256_storeu_pd(sums, sum);
+    _mm256_storeu_pd(sums_sq, sum_sq);
+    _mm256_storeu_ps(mins, min);
+    _mm256_storeu_ps(maxs, max);
+
+    accum.sum += (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    accum.sum_sq += (sums_sq[0] + sums_sq[1]) + (sums_sq[2] + sums_sq[3]);
+    accum.min = std::min(accum.min, *std::min_element(mins, mins + 8));
+    accum.max = std::max(accum.max, *std::max_element(maxs, maxs + 8));
+
+    ScalarKernel(values, valid, a, b, accum);
+}
+
+/**
+ * SSE2 row-wise kernel, processing 4 rows per step.
+ */
+void Sse2RowKernel(const float * const * columns,
+        const uint64_t * const * valid, const size_t num_columns, size_t a,
+        const size_t b, const size_t first, float * means, float * mins,
+        float * maxs) {
+
+    const __m128i bits = _mm_setr_epi32(1, 2, 4, 8);
+    const __m128 ones = _mm_set1_ps(1.0f);
+    const __m128 no_data = _mm_set1_ps(-1.0f);
+    const __m128 pos_inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+    const __m128 neg_inf = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+
+    for (; a + 4 <= b; a += 4) {
+
+        __m128 sum = _mm_setzero_ps(), count = _mm_setzero_ps();
+        __m128 min = pos_inf, max = neg_inf;
+
+        for (size_t c = 0; c < num_columns; c++) {
+
+            const int nibble = int((valid[c][a / 64] >> (a % 64)) & 0xF);
+            const __m128i lane_bits = _mm_and_si128(_mm_set1_epi32(nibble),
+                    bits);
+            const __m128 mask = _mm_castsi128_ps(
+                    _mm_cmpeq_epi32(lane_bits, bits));
+            const __m128 v = _mm_and_ps(_mm_loadu_ps(columns[c] + a), mask);
+
+            sum = _mm_add_ps(sum, v);
+            count = _mm_add_ps(count, _mm_and_ps(ones, mask));
+            min = _mm_min_ps(min, _mm_or_ps(v, _mm_andnot_ps(mask, pos_inf)));
+            max = _mm_max_ps(max, _mm_or_ps(v, _mm_andnot_ps(mask, neg_inf)));
+        }
+
+        const __m128 has_data = _mm_cmpgt_ps(count, _mm_setzero_ps());
+        const __m128 mean = _mm_div_ps(sum, _mm_max_ps(count, ones));
+
+        _mm_storeu_ps(means + a - first, _mm_or_ps(_mm_and_ps(has_data, mean),
+                    _mm_andnot_ps(has_data, no_data)));
+        _mm_storeu_ps(mins + a - first, _mm_or_ps(_mm_and_ps(has_data, min),
+                    _mm_andnot_ps(has_data, no_data)));
+        _mm_storeu_ps(maxs + a - first, _mm_or_ps(_mm_and_ps(has_data, max),
+                    _mm_andnot_ps(has_data, no_data)));
+    }
+
+    ScalarRowKernel(columns, valid, num_columns, a, b, first, means, mins,
+            maxs);
+}
+
+/**
+ * AVX2 row-wise kernel, processing 8 rows per step.
+ */
+__attribute__((target("avx2")))
+void Avx2RowKernel(const float * const * columns,
+        const uint64_t * const * valid, const size_t num_columns, size_t a,
+        const size_t b, const size_t first, float * means, float * mins,
+        float * maxs) {
+
+    const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m256 ones = _mm256_set1_ps(1.0f);
+    const __m256 no_data = _mm256_set1_ps(-1.0f);
+    const __m256 pos_inf = _mm256_set1_ps(
+            std::numeric_limits<float>::infinity());
+    const __m256 neg_inf = _mm256_set1_ps(
+            -std::numeric_limits<float>::infinity());
+
+    for (; a + 8 <= b; a += 8) {
+
+        __m256 sum = _mm256_setzero_ps(), count = _mm256_setzero_ps();
+        __m256 min = pos_inf, max = neg_inf;
+
+        for (size_t c = 0; c < num_columns; c++) {
+
+            const int byte = int((valid[c][a / 64] >> (a % 64)) & 0xFF);
+            const __m256i lane_bits = _mm256_and_si256(
+                    _mm256_set1_epi32(byte), bits);
+            const __m256 mask = _mm256_castsi256_ps(
+                    _mm256_cmpeq_epi32(lane_bits, bits));
+            const __m256 v = _mm256_and_ps(_mm256_loadu_ps(columns[c] + a),
+                    mask);
+
+            sum = _mm256_add_ps(sum, v);
+            count = _mm256_add_ps(count, _mm256_and_ps(ones, mask));
+            min = _mm256_min_ps(min, _mm256_blendv_ps(pos_inf, v, mask));
+            max = _mm256_max_ps(max, _mm256_blendv_ps(neg_inf, v, mask));
+        }
+
+        const __m256 has_data = _mm256_cmp_ps(count, _mm256_setzero_ps(),
+                _CMP_GT_OQ);
+        const __m256 mean = _mm256_div_ps(sum, _mm256_max_ps(count, ones));
+
+        _mm256_storeu_ps(means + a - first,
+                _mm256_blendv_ps(no_data, mean, has_data));
+        _mm256_storeu_ps(mins + a - first,
+                _mm256_blendv_ps(no_data, min, has_data));
+        _mm256_storeu_ps(maxs + a - first,
+                _mm256_blendv_ps(no_data, max, has_data));
+    }
+
+    ScalarRowKernel(columns, valid, num_columns, a, b, first, means, mins,
+            maxs);
+}
+
+/**
+ * SSE2 natural logarithm kernel, processing 4 values per step.
+ */
+void Sse2LogKernel(float * values, const size_t size) {
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 min_norm = _mm_set1_ps(std::numeric_limits<float>::min());
+    const __m128i mantissa_mask = _mm_set1_epi32(0x807FFFFF);
+    const __m128i half_exponent = _mm_set1_epi32(0x3F000000);
+
+    size_t i = 0;
+
+    for (; i + 4 <= size; i += 4) {
+
+        const __m128 v = _mm_loadu_ps(values + i);
+        const __m128 is_positive = _mm_cmpgt_ps(v, zero);
+        __m128 x = _mm_max_ps(v, min_norm);
+
+        // splits x in 2^e * m, with m in [0.5, 1)
+        const __m128i bits = _mm_castps_si128(x);
+        __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23),
+                    _mm_set1_epi32(126)));
+        x = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, mantissa_mask),
+                    half_exponent));
+
+        // moves m to [sqrt(1/2), sqrt(2)) and takes x = m - 1
+        const __m128 is_small = _mm_cmplt_ps(x, _mm_set1_ps(kSqrtHalf));
+        e = _mm_sub_ps(e, _mm_and_ps(one, is_small));
+        x = _mm_sub_ps(_mm_add_ps(x, _mm_and_ps(x, is_small)), one);
+
+        const __m128 z = _mm_mul_ps(x, x);
+        __m128 y = _mm_set1_ps(kLogP[0]);
+        for (int k = 1; k < 9; k++)
+            y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(kLogP[k]));
+        y = _mm_mul_ps(_mm_mul_ps(y, x), z);
+
+        y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(kLogQ1)));
+        y = _mm_sub_ps(y, _mm_mul_ps(z, half));
+        x = _mm_add_ps(_mm_add_ps(x, y), _mm_mul_ps(e, _mm_set1_ps(kLogQ2)));
+
+        _mm_storeu_ps(values + i, _mm_or_ps(_mm_and_ps(is_positive, x),
+                    _mm_andnot_ps(is_positive, v)));
+    }
+
+    ScalarLogKernel(values + i, size - i);
+}
+
+/**
+ * AVX2 natural logarithm kernel, processing 8 values per step.
+ */
+__attribute__((target("avx2")))
+void Avx2LogKernel(float * values, const size_t size) {
+
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 min_norm = _mm256_set1_ps(
+            std::numeric_limits<float>::min());
+    const __m256i mantissa_mask = _mm256_set1_epi32(0x807FFFFF);
+    const __m256i half_exponent = _mm256_set1_epi32(0x3F000000);
+
+    size_t i = 0;
+
+    for (; i + 8 <= size; i += 8) {
+
+        const __m256 v = _mm256_loadu_ps(values + i);
+        const __m256 is_positive = _mm256_cmp_ps(v, zero, _CMP_GT_OQ);
+        __m256 x = _mm256_max_ps(v, min_norm);
+
+        // splits x in 2^e * m, with m in [0.5, 1)
+        const __m256i bits = _mm256_castps_si256(x);
+        __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(
+                    _mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126)));
+        x = _mm256_castsi256_ps(_mm256_or_si256(
+                    _mm256_and_si256(bits, mantissa_mask), half_exponent));
+
+        // moves m to [sqrt(1/2), sqrt(2)) and takes x = m - 1
+        const __m256 is_small = _mm256_cmp_ps(x, _mm256_set1_ps(kSqrtHalf),
+                _CMP_LT_OQ);
+        e = _mm256_sub_ps(e, _mm256_and_ps(one, is_small));
+        x = _mm256_sub_ps(_mm256_add_ps(x, _mm256_and_ps(x, is_small)), one);
+
+        const __m256 z = _mm256_mul_ps(x, x);
+        __m256 y = _mm256_set1_ps(kLogP[0]);
+        for (int k = 1; k < 9; k++)
+            y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(kLogP[k]));
+        y = _mm256_mul_ps(_mm256_mul_ps(y, x), z);
+
+        y = _mm256_add_ps(y, _mm256_mul_ps(e, _mm256_set1_ps(kLogQ1)));
+        y = _mm256_sub_ps(y, _mm256_mul_ps(z, half));
+        x = _mm256_add_ps(_mm256_add_ps(x, y),
+                _mm256_mul_ps(e, _mm256_set1_ps(kLogQ2)));
+
+        _mm256_storeu_ps(values + i, _mm256_blendv_ps(v, x, is_positive));
+    }
+
+    ScalarLogKernel(values + i, size - i);
+}
+
+#endif
+
+/// Selected kernel data structure.
+struct Isa {
+    Kernel kernel; ///< Kernel function.
+    RowKernel row_kernel; ///< Row-wise kernel function.
+    TransformKernel log_kernel; ///< Natural logarithm kernel function.
+    size_t block; ///< Number of values per kernel step.
+    const char * name; ///< Instruction set name.
+};
+
+/**
+ * Gets the kernels supported by the current CPU, from best to worst,
+ * detecting them only once.
+ */
+const std::vector<Isa> & GetIsas() {
+
+    static const std::vector<Isa> isas = [] {
+        std::vector<Isa> supported;
+#if defined(__x86_64__) || defined(__i386__)
+        if (__builtin_cpu_supports("avx2"))
+            supported.push_back({Avx2Kernel, Avx2RowKernel, Avx2LogKernel, 8,
+                    "avx2"});
+        if (__builtin_cpu_supports("sse2"))
+            supported.push_back({Sse2Kernel, Sse2RowKernel, Sse2LogKernel, 4,
+                    "sse2"});
+#endif
+        supported.push_back({ScalarKernel, ScalarRowKernel, ScalarLogKernel,
+                1, "scalar"});
+        return supported;
+    }();
+
+    return isas;
+}
+
+/// Selected kernel, the best one supported unless set with SetIsa().
+std::atomic<const Isa *> selected_isa(nullptr);
+
+/**
+ * Gets the selected kernel.
+ */
+const Isa & GetIsa() {
+
+    const Isa * isa = selected_isa.load(std::memory_order_relaxed);
+
+    return isa ? *isa : GetIsas().front();
+}
+
+}
+
+/**
+ * Reduces the valid values in the range [a, b) to their statistics.
+ *
+ * @param values Pointer to the first value of the column.
+ * @param valid Packed validity bitmap words of the column.
+ * @param a,b First and one past last positions of the range.
+ * @return Statistics of the valid values in the range.
+ */
+RangeStats Reduce(const float * values, const uint64_t * valid,
+        const size_t a, const size_t b) {
+
+    RangeStats stats;
+    if (a >= b)
+        return stats;
+
+    const Isa & isa = GetIsa();
+    Accum accum;
+
+    // aligns the start of the vectorized part with validity bitmap bytes
+    const size_t aligned_a = std::min(b, (a + isa.block - 1)
+            / isa.block * isa.block);
+    ScalarKernel(values, valid, a, aligned_a, accum);
+    isa.kernel(values, valid, aligned_a, b, accum);
+
+    stats.count = Count(valid, a, b);
+    stats.first = FirstValid(valid, a, b);
+    stats.last = LastValid(valid, a, b);
+
+    if (stats.count > 0) {
+        stats.sum = accum.sum;
+        stats.sum_sq = accum.sum_sq;
+        stats.min = accum.min;
+        stats.max = accum.max;
+    }
+
+    return stats;
+}
+
+/**
+ * Counts the valid values in the range [a, b).
+ *
+ * @param valid Packed validity bitmap words of the column.
+ * @param a,b First and one past last positions of the range.
+ * @return Number of valid values.
+ */
+size_t Count(const uint64_t * valid, const size_t a, const size_t b) {
+
+    size_t count = 0;
+
+    for (size_t i = a; i < b; ) {
+        const size_t bit = i % 64;
+        const size_t n = std::min(size_t(64) - bit, b - i);
+        const uint64_t mask = (n == 64) ? ~uint64_t(0)
+            : ((uint64_t(1) << n) - 1) << bit;
+        count += __builtin_popcountll(valid[i / 64] & mask);
+        i += n;
+    }
+
+    return count;
+}
+
+/**
+ * Finds the first valid value in the range [a, b).
+ *
+ * @param valid Packed validity bitmap words of the column.
+ * @param a,b First and one past last positions of the range.
+ * @return Position of the first valid value or -1.
+ */
+long FirstValid(const uint64_t * valid, const size_t a, const size_t b) {
+
+    for (size_t i = a; i < b; ) {
+        const size_t bit = i % 64;
+        const size_t n = std::min(size_t(64) - bit, b - i);
+        const uint64_t mask = (n == 64) ? ~uint64_t(0)
+            : ((uint64_t(1) << n) - 1) << bit;
+        const uint64_t word = valid[i / 64] & mask;
+        if (word)
+            return long(i - bit + __builtin_ctzll(word));
+        i += n;
+    }
+
+    return -1;
+}
+
+/**
+ * Finds the last valid value in the range [a, b).
+ *
+ * @param valid Packed validity bitmap words of the column.
+ * @param a,b First and one past last positions of the range.
+ * @return Position of the last valid value or -1.
+ */
+long LastValid(const uint64_t * valid, const size_t a, const size_t b) {
+
+    for (size_t i = b; i > a; ) {
+        const size_t start = std::max(a, (i - 1) / 64 * 64);
+        const size_t bit = start % 64;
+        const size_t n = i - start;
+        const uint64_t mask = (n == 64) ? ~uint64_t(0)
+            : ((uint64_t(1) << n) - 1) << bit;
+        const uint64_t word = valid[start / 64] & mask;
+        if (word)
+            return long(start - bit + 63 - __builtin_clzll(word));
+        i = start;
+    }
+
+    return -1;
+}
+
+/**
+ * Reduces the rows [a, b) of several columns, each one to the mean,
+ * minimum and maximum of its valid values across the columns.
+ *
+ * @param columns Pointers to the first value of every column.
+ * @param valid Packed validity bitmap words of every column.
+ * @param num_columns Number of columns.
+ * @param a,b First and one past last rows of the range.
+ * @param means,mins,maxs Outputs of b - a values, where row i is stored
+ * at position i - a, or -1 if the row has no valid values.
+ */
+void ReduceRows(const float * const * columns,
+        const uint64_t * const * valid, const size_t num_columns,
+        const size_t a, const size_t b, float * means, float * mins,
+        float * maxs) {
+
+    if (a >= b)
+        return;
+
+    const Isa & isa = GetIsa();
+
+    // aligns the start of the vectorized part with validity bitmap bytes
+    const size_t aligned_a = std::min(b, (a + isa.block - 1)
+            / isa.block * isa.block);
+    ScalarRowKernel(columns, valid, num_columns, a, aligned_a, a, means,
+            mins, maxs);
+    isa.row_kernel(columns, valid, num_columns, aligned_a, b, a, means,
+            mins, maxs);
+}
+
+/**
+ * Reduces the rows [a, b) of several columns, each one to the median of
+ * its valid values across the columns. It is not vectorized, since every
+ * row needs a partial sort.
+ *
+ * @param columns Pointers to the first value of every column.
+ * @param valid Packed validity bitmap words of every column.
+ * @param num_columns Number of columns.
+ * @param a,b First and one past last rows of the range.
+ * @param medians Output of b - a values, where row i is stored at position
+ * i - a, or -1 if the row has no valid values.
+ */
+void MedianRows(const float * const * columns,
+        const uint64_t * const * valid, const size_t num_columns,
+        const size_t a, const size_t b, float * medians) {
+
+    std::vector<float> row(num_columns);
+
+    for (size_t i = a; i < b; i++) {
+
+        size_t n = 0;
+        for (size_t c = 0; c < num_columns; c++)
+            if (IsValid(valid[c], i))
+                row[n++] = columns[c][i];
+
+        if (n == 0) {
+            medians[i - a] = -1.0f;
+            continue;
+        }
+
+        const auto mid = row.begin() + n / 2;
+        std::nth_element(row.begin(), mid, row.begin() + n);
+        float median = *mid;
+
+        if (n % 2 == 0)
+            median = (median + *std::max_element(row.begin(), mid)) / 2;
+
+        medians[i - a] = median;
+    }
+}
+
+/**
+ * Replaces values by their natural logarithm, leaving values not greater
+ * than 0 as they are. The vectorized versions use a polynomial
+ * approximation, which differs from std::log() by a couple of float ulps
+ * at most.
+ *
+ * @param values Pointer to the first value.
+ * @param size Number of values.
+ */
+void LogInPlace(float * values, const size_t size) {
+
+    GetIsa().log_kernel(values, size);
+}
+
+/**
+ * Gets the name of the instruction set used by the kernels.
+ *
+ * @return Instruction set name.
+ */
+const char * GetIsaName() {
+
+    return GetIsa().name;
+}
+
+/**
+ * Gets the names of the instruction sets supported by the current CPU,
+ * from best to worst, ending with 'scalar'.
+ *
+ * @return Instruction set names.
+ */
+std::vector<std::string> GetIsaNames() {
+
+    std::vector<std::string> names;
+
+    for (const Isa & isa : GetIsas())
+        names.push_back(isa.name);
+
+    return names;
+}
+
+/**
+ * Selects the instruction set used by the kernels from then on, for
+ * example to test every one of them. It must not be called while kernels
+ * are running.
+ *
+ * @param name Instruction set name, as given by GetIsaNames().
+ * @return False if the instruction set is not supported, in which case
+ * the selection is unchanged.
+ */
+bool SetIsa(const std::string & name) {
+
+    for (const Isa & isa : GetIsas()) {
+        if (name == isa.name) {
+            selected_isa.store(&isa, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/**
+ * Vectorized reduction kernels over a range of a column of values with a
+ * packed validity bitmap, as stored in BtcData, and row-wise across the
+ * same range of several such columns, plus batch transforms of values.
+ *
+ * AVX2 or SSE2 versions are selected at runtime according to the CPU,
+ * with a scalar fallback. Sums of column ranges are accumulated in double
+ * precision, so results stay stable on long ranges.
+ */
+namespace kernels {
+
+/// Statistics of the valid values in a range data structure.
+struct RangeStats {
+    size_t count = 0; ///< Number of valid values.
+    double sum = 0.0; ///< Sum of valid values.
+    double sum_sq = 0.0; ///< Sum of squares of valid values.
+    float min = -1.0f; ///< Minimum valid value or -1.
+    float max = -1.0f; ///< Maximum valid value or -1.
+    long first = -1; ///< Position of the first valid value or -1.
+    long last = -1; ///< Position of the last valid value or -1.
+};
+
+RangeStats Reduce(const float * values, const uint64_t * valid,
+        const size_t a, const size_t b);
+size_t Count(const uint64_t * valid, const size_t a, const size_t b);
+long FirstValid(const uint64_t * valid, const size_t a, const size_t b);
+long LastValid(const uint64_t * valid, const size_t a, const size_t b);
+void ReduceRows(const float * const * columns,
+        const uint64_t * const * valid, const size_t num_columns,
+        const size_t a, const size_t b, float * means, float * mins,
+        float * maxs);
+void MedianRows(const float * const * columns,
+        const uint64_t * const * valid, const size_t num_columns,
+        const size_t a, const size_t b, float * medians);
+void LogInPlace(float * values, const size_t size);
+const char * GetIsaName();
+std::vector<std::string> GetIsaNames();
+bool SetIsa(const std::string & name);
+
+}
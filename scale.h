@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include "range_kernels.h"
+#include "utils.h"
+
+/**
+ * Linear scale policy, for code specialized for a scale at compile time.
+ */
+struct LinearScale {
+
+    /**
+     * Applies scale to value and returns it.
+     *
+     * @param value Value.
+     * @return Same value.
+     */
+    static float Apply(const float value) {
+
+        return value;
+    }
+
+    /**
+     * Applies scale to values in place, which leaves them as they are.
+     */
+    static void ApplyBatch(float *, const size_t) {}
+};
+
+/**
+ * Logarithmic scale policy, for code specialized for a scale at compile
+ * time. Values not greater than 0 are left as they are, like in
+ * utils::ApplyScale().
+ */
+struct LogScale {
+
+    /**
+     * Applies scale to value and returns it.
+     *
+     * @param value Value.
+     * @return Natural logarithm of value, or value if it is not positive.
+     */
+    static float Apply(const float value) {
+
+        return utils::ApplyScale(utils::kLogarithmic, value);
+    }
+
+    /**
+     * Applies scale to values in place, in a vectorized batch.
+     *
+     * @param values Pointer to the first value.
+     * @param size Number of values.
+     */
+    static void ApplyBatch(float * values, const size_t size) {
+
+        kernels::LogInPlace(values, size);
+    }
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <iostream>
+
+
+/**
+ * Minimal checks for the test programs, which report every failed check
+ * and exit with the number of failures.
+ */
+namespace check {
+
+/**
+ * Gets the number of failed checks.
+ *
+ * @return Reference to the number of failed checks.
+ */
+inline int & NumFailures() {
+
+    static int num_failures = 0;
+    return num_failures;
+}
+
+/**
+ * Reports a failed check.
+ *
+ * @param file,line Location of the check.
+ * @param expr Checked expression.
+ */
+inline void Fail(const char * file, const int line, const char * expr) {
+
+    std::cerr << file << ':' << line << ": check failed: " << expr << '\n';
+    NumFailures()++;
+}
+
+}
+
+#define CHECK(expr) \
+    do { if (!(expr)) check::Fail(__FILE__, __LINE__, #expr); } while (0)
@@ -0,0 +1,403 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include "../btc_data.h"
+#include "check.h"
+
+
+namespace {
+
+/**
+ * Writes a file, truncating it in place, so it keeps its inode.
+ *
+ * @param path File path.
+ * @param contents File contents.
+ */
+void WriteFile(const std::string & path, const std::string & contents) {
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << contents;
+}
+
+/**
+ * Makes a CSV file with one row per day from 2010-07-17 (day 554).
+ *
+ * @param prices Price of each day, with the same number of characters.
+ * @return CSV file contents.
+ */
+std::string MakeCsv(const std::vector<std::string> & prices) {
+
+    std::string csv = "Time,a,b\n";
+
+    for (size_t i = 0; i < prices.size(); i++) {
+        char date[32];
+        snprintf(date, sizeof(date), "2010-07-%02d 00:00:00 UTC",
+                int(17 + i));
+        csv += std::string(date) + "," + prices[i] + ",\n";
+    }
+
+    return csv;
+}
+
+/**
+ * Checks that reloading a CSV file rewritten in place gives the same data
+ * as loading it from scratch.
+ *
+ * @param path CSV file path.
+ * @param before,after CSV file contents before and after the rewrite.
+ */
+void CheckReloadAfterRewrite(const std::string & path,
+        const std::string & before, const std::string & after) {
+
+    remove((path + ".cache").c_str());
+    WriteFile(path, before);
+    const auto btc_data = std::make_shared<const BtcData>(path);
+
+    WriteFile(path, after);
+    const auto reloaded = BtcData::Reload(btc_data);
+
+    remove((path + ".cache").c_str());
+    const BtcData loaded(path);
+
+    CHECK(reloaded->GetLastDay() == loaded.GetLastDay());
+    CHECK(reloaded->GetNumDays(0, 1000) == loaded.GetNumDays(0, 1000));
+    for (int day = 540; day <= loaded.GetLastDay(); day++)
+        CHECK(reloaded->GetPrice(day) == loaded.GetPrice(day));
+}
+
+/**
+ * Makes CSV lines of rows a minute apart, with prices of two exchanges,
+ * the second one only on some rows.
+ *
+ * @param first,last First and one past last rows.
+ * @return CSV lines.
+ */
+std::string MakeMinuteLines(const int first, const int last) {
+
+    std::string lines;
+
+    for (int i = first; i < last; i++) {
+        lines += std::to_string(BtcData::TimeOfDay(554) + int64_t(i) * 60)
+            + "," + std::to_string(100 + i % 50) + ","
+            + ((i % 3 == 0) ? std::string() : std::to_string(90 + i % 13))
+            + "\n";
+    }
+
+    return lines;
+}
+
+/**
+ * Checks that the cache file with the rows appended by a reload, across
+ * the end of a block, gives the same data as parsing the CSV file.
+ *
+ * @param path CSV file path.
+ */
+void CheckReloadCache(const std::string & path) {
+
+    const int num_rows = int(BtcData::kBlockRows_) - 2;
+    const std::string csv = "Time,a,b\n" + MakeMinuteLines(0, num_rows);
+
+    remove((path + ".cache").c_str());
+    WriteFile(path, csv);
+    const auto btc_data = std::make_shared<const BtcData>(path);
+
+    WriteFile(path, csv + MakeMinuteLines(num_rows, num_rows + 5));
+    const auto reloaded = BtcData::Reload(btc_data);
+    const BtcData cached(path);
+
+    remove((path + ".cache").c_str());
+    const BtcData loaded(path);
+
+    CHECK(reloaded->GetNumRows() == size_t(num_rows + 5));
+    CHECK(cached.GetNumRows() == loaded.GetNumRows());
+    CHECK(cached.GetLastTime() == loaded.GetLastTime());
+
+    const int64_t time_a = BtcData::TimeOfDay(554);
+    const int64_t time_b = time_a + int64_t(num_rows + 5) * 60;
+    const auto columns = cached.ResampleExchanges(time_a, time_b, 61,
+            {0, 1}, BtcData::kMeanPrice);
+    const auto loaded_columns = loaded.ResampleExchanges(time_a, time_b, 61,
+            {0, 1}, BtcData::kMeanPrice);
+
+    for (size_t x = 0; x < columns.size(); x++) {
+        CHECK(columns[x].avg == loaded_columns[x].avg);
+        CHECK(columns[x].last == loaded_columns[x].last);
+    }
+}
+
+/**
+ * Checks that chart columns cover the same days as the day mapping of
+ * charts drawn day by day, where column x covers days [day_a + (x - 1) *
+ * days / width, day_a + x * days / width).
+ *
+ * @param btc_data Daily Bitcoin data.
+ * @param day_a,day_b First and last days of the chart.
+ * @param width Number of columns.
+ */
+void CheckResampleDays(const BtcData & btc_data, const int day_a,
+        const int day_b, const int width) {
+
+    const auto columns = btc_data.Resample(BtcData::TimeOfDay(day_a),
+            BtcData::TimeOfDay(day_b), width);
+
+    auto x_to_day = [&](const int x) {
+        return day_a + x * (day_b - day_a) / width;
+    };
+
+    for (int x = 0; x < width; x++) {
+        const int start_day = x_to_day(x - 1), end_day = x_to_day(x);
+        const float avg = btc_data.GetAvgPrice(start_day, end_day);
+        CHECK(std::fabs(columns[x].avg - avg) <= 1e-5f * std::fabs(avg));
+        CHECK(columns[x].min == btc_data.GetMinPrice(start_day, end_day));
+        // GetMaxPrice() gives 0 instead of -1 without data
+        if (btc_data.GetNumDays(start_day, end_day) > 0)
+            CHECK(columns[x].max
+                    == btc_data.GetMaxPrice(start_day, end_day));
+    }
+}
+
+
+/**
+ * Checks that appending rows one by one to copies of a snapshot, as
+ * reloads do, with both Append() and AppendCsv(), leaves the previous
+ * snapshots unchanged, while they share their sealed blocks with the
+ * copies.
+ */
+void CheckAppendShares() {
+
+    const size_t num_rows = 3 * BtcData::kBlockRows_ + 100;
+    const size_t kept_rows = BtcData::kBlockRows_ + 10;
+    const int64_t time_a = BtcData::TimeOfDay(554);
+
+    auto btc_data = std::make_shared<const BtcData>("");
+    std::shared_ptr<const BtcData> kept;
+    std::vector<BtcData::ColumnPrices> kept_columns;
+
+    for (size_t i = 0; i < num_rows; i++) {
+
+        auto next = std::make_shared<BtcData>(*btc_data);
+
+        BtcData::TimeBtcData time_btc_data;
+        time_btc_data.time = time_a + int64_t(i) * 60;
+        time_btc_data.price = (i % 7 == 0) ? -1.0f : float(100 + i % 50);
+
+        if (i % 2 == 0) {
+            CHECK(next->Append(time_btc_data));
+        } else {
+            const std::string line = std::to_string(time_btc_data.time)
+                + "," + std::to_string(time_btc_data.price) + "\n";
+            CHECK(next->AppendCsv(line) == 1);
+        }
+
+        CHECK(btc_data->GetNumRows() == i);
+        CHECK(next->GetNumRows() == i + 1);
+        CHECK(next->CountSharedBlocks(*btc_data)
+                == i / BtcData::kBlockRows_);
+
+        btc_data = next;
+
+        if (btc_data->GetNumRows() == kept_rows) {
+            kept = btc_data;
+            kept_columns = kept->Resample(time_a,
+                    time_a + int64_t(num_rows) * 60, 97);
+        }
+    }
+
+    CHECK(kept->GetNumRows() == kept_rows);
+    CHECK(kept->GetLastTime() == time_a + int64_t(kept_rows - 1) * 60);
+    CHECK(btc_data->CountSharedBlocks(*kept) == 1);
+
+    const auto columns = kept->Resample(time_a,
+            time_a + int64_t(num_rows) * 60, 97);
+
+    for (size_t x = 0; x < columns.size(); x++) {
+        CHECK(columns[x].avg == kept_columns[x].avg);
+        CHECK(columns[x].min == kept_columns[x].min);
+        CHECK(columns[x].max == kept_columns[x].max);
+        CHECK(columns[x].last == kept_columns[x].last);
+    }
+}
+
+/**
+ * Checks that two sets of aggregated prices are equal, up to the rounding
+ * of averages summed in another order.
+ *
+ * @param columns,expected Aggregated prices.
+ */
+void CheckColumns(const std::vector<BtcData::ColumnPrices> & columns,
+        const std::vector<BtcData::ColumnPrices> & expected) {
+
+    CHECK(columns.size() == expected.size());
+
+    for (size_t x = 0; x < std::min(columns.size(), expected.size()); x++) {
+        CHECK(std::fabs(columns[x].avg - expected[x].avg)
+                <= 1e-5f * std::fabs(expected[x].avg));
+        CHECK(columns[x].min == expected[x].min);
+        CHECK(columns[x].max == expected[x].max);
+        CHECK(columns[x].first == expected[x].first);
+        CHECK(columns[x].last == expected[x].last);
+    }
+}
+
+/**
+ * Checks that data loaded in compressed mode gives the same results as
+ * plain data, with less memory, for minute rows with a first block with
+ * gaps, a sparse block after a gap of a month, rows without prices, and
+ * rows appended by a reload.
+ *
+ * @param path CSV file path.
+ */
+void CheckCompressed(const std::string & path) {
+
+    const int64_t time_a = BtcData::TimeOfDay(554);
+    const int num_rows = 3 * int(BtcData::kBlockRows_) + 500;
+    std::string csv = "Time,a,b\n";
+    int64_t time = time_a;
+
+    for (int i = 0; i < num_rows; i++) {
+        time += (i == 2 * int(BtcData::kBlockRows_) + 10) ? 30 * 86400
+            : (i < int(BtcData::kBlockRows_) && i % 1000 == 999) ? 3600 : 60;
+        csv += std::to_string(time) + ","
+            + ((i % 17 == 0) ? std::string() : std::to_string(100 + i % 50))
+            + "," + ((i % 3 == 0) ? std::string()
+                    : std::to_string(90 + i % 13)) + "\n";
+    }
+
+    remove((path + ".cache").c_str());
+    WriteFile(path, csv);
+    const BtcData plain(path);
+    remove((path + ".cache").c_str());
+    const auto compressed = std::make_shared<const BtcData>(path, true);
+    const BtcData cached(path);
+
+    CHECK(compressed->GetNumRows() == plain.GetNumRows());
+    CHECK(compressed->GetLastTime() == plain.GetLastTime());
+    CHECK(compressed->MemoryBytes() < plain.MemoryBytes() * 2 / 3);
+
+    for (int64_t t = time_a - 60; t <= time + 60; t += 7 * 60 + 13)
+        CHECK(compressed->IndexOfTime(t) == plain.IndexOfTime(t));
+
+    const int64_t time_b = time + 60;
+    for (const int width : {7, 97, 1024}) {
+        CheckColumns(compressed->Resample(time_a, time_b, width),
+                plain.Resample(time_a, time_b, width));
+        CheckColumns(compressed->Resample(time_a + 1234, time_a + 98765,
+                    width), plain.Resample(time_a + 1234, time_a + 98765,
+                    width));
+    }
+    CheckColumns(compressed->ResampleBuckets(time_a, time_b, 3600),
+            plain.ResampleBuckets(time_a, time_b, 3600));
+    CheckColumns(compressed->ResampleExchanges(time_a, time_b, 97, {0, 1},
+                BtcData::kMedianPrice), plain.ResampleExchanges(time_a,
+                time_b, 97, {0, 1}, BtcData::kMedianPrice));
+
+    // the cache file written from compressed blocks holds the same rows
+    CheckColumns(cached.Resample(time_a, time_b, 97),
+            plain.Resample(time_a, time_b, 97));
+
+    for (int day = 553; day <= plain.GetLastDay() + 1; day += 3) {
+
+        const auto stats = compressed->GetStats(day, day + 5);
+        const auto expected = plain.GetStats(day, day + 5);
+        CHECK(stats.num_days == expected.num_days);
+        CHECK(std::fabs(stats.avg - expected.avg)
+                <= 1e-5f * std::fabs(expected.avg));
+        CHECK(stats.first == expected.first);
+        CHECK(stats.last == expected.last);
+
+        const auto ohlc = compressed->GetOhlc(day, day + 5);
+        const auto expected_ohlc = plain.GetOhlc(day, day + 5);
+        CHECK(ohlc.count == expected_ohlc.count);
+        CHECK(ohlc.open == expected_ohlc.open);
+        CHECK(ohlc.high == expected_ohlc.high);
+        CHECK(ohlc.low == expected_ohlc.low);
+        CHECK(ohlc.close == expected_ohlc.close);
+    }
+
+    // rows appended by a reload across the end of a block, which is
+    // compressed when sealed
+    std::string lines;
+    for (int i = 0; i < int(BtcData::kBlockRows_); i++)
+        lines += std::to_string(time + int64_t(i + 1) * 60) + ","
+            + std::to_string(200 + i % 30) + ",\n";
+
+    WriteFile(path, csv + lines);
+    const auto reloaded = BtcData::Reload(compressed);
+    remove((path + ".cache").c_str());
+    const BtcData loaded(path);
+
+    CHECK(reloaded->GetNumRows() == loaded.GetNumRows());
+    CHECK(reloaded->CountSharedBlocks(*compressed) == 3);
+    CheckColumns(reloaded->Resample(time_a, loaded.GetLastTime() + 60, 97),
+            loaded.Resample(time_a, loaded.GetLastTime() + 60, 97));
+}
+
+}
+
+int main() {
+
+    char dir[] = "/tmp/btc_charts_test_XXXXXX";
+    if (!mkdtemp(dir))
+        return 1;
+    const std::string path = std::string(dir) + "/price.csv";
+
+    const std::string csv = MakeCsv({"15.000000", "16.000000", "17.000000"});
+
+    // rows only appended
+    CheckReloadAfterRewrite(path, csv, csv + MakeCsv({"15.000000",
+                "16.000000", "17.000000", "18.000000"}).substr(csv.size()));
+
+    // first rows rewritten with lines of the same length, plus a new row
+    CheckReloadAfterRewrite(path, csv, MakeCsv({"90.000000", "91.000000",
+                "17.000000", "18.000000"}));
+
+    // rewritten keeping the same size
+    CheckReloadAfterRewrite(path, csv, MakeCsv({"90.000000", "16.000000",
+                "17.000000"}));
+
+    // rewritten with longer lines, so the extracted bytes end mid-line
+    CheckReloadAfterRewrite(path, csv, MakeCsv({"150.000000", "160.000000",
+                "170.000000"}));
+
+    // rows appended to the cache file across the end of a block
+    CheckReloadCache(path);
+
+    // rows appended before the last row
+    CheckReloadAfterRewrite(path, csv, csv + "2010-07-10 00:00:00 UTC,"
+            "18.000000,\n");
+
+    // chart columns of daily data, with a missing day
+    std::string daily_csv = "Time,a,b\n";
+    for (int i = 0; i < 400; i++) {
+        if (i == 123)
+            continue;
+        char line[64];
+        const int64_t time = BtcData::TimeOfDay(554 + i);
+        snprintf(line, sizeof(line), "%lld,%d.5,\n", (long long)time,
+                100 + (i * 37) % 101);
+        daily_csv += line;
+    }
+    remove((path + ".cache").c_str());
+    WriteFile(path, daily_csv);
+    const BtcData daily(path);
+    CheckResampleDays(daily, 554, 954, 97);
+    CheckResampleDays(daily, 560, 900, 1024);
+    CheckResampleDays(daily, 500, 1000, 7);
+
+    // rows appended one by one to copies of snapshots
+    CheckAppendShares();
+
+    // sealed blocks compressed
+    CheckCompressed(path);
+
+    remove((path + ".cache").c_str());
+    remove(path.c_str());
+    rmdir(dir);
+
+    return check::NumFailures();
+}
@@ -0,0 +1,58 @@
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include "../chart_batch.h"
+#include "check.h"
+
+
+namespace {
+
+/**
+ * Reads a manifest with a single line.
+ *
+ * @param dir Directory where to write the manifest.
+ * @param line Manifest line.
+ * @return Number of charts read from the manifest.
+ */
+size_t NumJobs(const std::string & dir, const std::string & line) {
+
+    const std::string path = dir + "/manifest.txt";
+    std::ofstream(path, std::ios::trunc) << line << '\n';
+
+    ChartBatch batch;
+    batch.ReadManifest(path);
+    std::remove(path.c_str());
+
+    return batch.NumJobs();
+}
+
+}
+
+int main() {
+
+    char dir_template[] = "/tmp/btc_charts_test_XXXXXX";
+    const std::string dir = mkdtemp(dir_template);
+
+    const std::string line = "a.png 800 300 2012-01-01 2013-01-01 1 1000 log";
+
+    // lines with every optional field
+    CHECK(NumJobs(dir, line) == 1);
+    CHECK(NumJobs(dir, line + " envelope all median") == 1);
+
+    // lines with leftover or malformed tokens
+    CHECK(NumJobs(dir, line + " envelope all median volume extra") == 0);
+    CHECK(NumJobs(dir, line + " avg") == 1);
+
+    // lines with a series, with or without exchanges
+    CHECK(NumJobs(dir, line + " avg - mean volume") == 1);
+    CHECK(NumJobs(dir, line + " envelope all median block_time") == 1);
+    CHECK(NumJobs(dir, line + " avg - mean volume extra") == 0);
+    CHECK(NumJobs(dir, "a.png 800x 300 2012-01-01 2013-01-01 1 1000 log")
+            == 0);
+    CHECK(NumJobs(dir, line + "x") == 0);
+
+    rmdir(dir.c_str());
+
+    return check::NumFailures();
+}
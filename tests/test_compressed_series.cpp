@@ -0,0 +1,301 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+#include "../compressed_series.h"
+#include "check.h"
+
+
+namespace {
+
+/// Point of a series data structure, as appended.
+struct Point {
+    int64_t time; ///< Seconds since 1970-01-01 00:00:00 UTC.
+    float value; ///< Value.
+    bool is_valid; ///< Whether the point has data.
+};
+
+/**
+ * Checks whether a point has data, as stored by the series, where NaN
+ * values have none.
+ */
+bool HasData(const Point & point) {
+
+    return point.is_valid && !std::isnan(point.value);
+}
+
+/**
+ * Checks whether two sums are equal up to the rounding of adding values in
+ * another order.
+ */
+bool IsClose(const double x, const double y) {
+
+    return std::fabs(x - y) <= 1e-9 * std::max(std::fabs(x), std::fabs(y));
+}
+
+/**
+ * Appends points to a new series and checks that decoding every block
+ * gives them back bit for bit, with no data where they had none.
+ *
+ * @param points Points, sorted by time.
+ * @return Series of the points.
+ */
+CompressedSeries CheckRoundTrip(const std::vector<Point> & points) {
+
+    CompressedSeries series;
+    for (const Point & point : points)
+        CHECK(series.Append(point.time, point.value, point.is_valid));
+
+    CHECK(series.Size() == points.size());
+    CHECK(series.NumBlocks() == (points.size()
+                + CompressedSeries::kBlockSize_ - 1)
+            / CompressedSeries::kBlockSize_);
+
+    std::vector<int64_t> times;
+    std::vector<float> values;
+    Bitmap valid;
+    size_t i = 0;
+
+    for (size_t k = 0; k < series.NumBlocks(); k++) {
+
+        series.DecodeBlock(k, times, values, valid);
+        CHECK(times.size() == std::min(CompressedSeries::kBlockSize_,
+                    points.size() - i));
+
+        for (size_t j = 0; j < times.size(); j++, i++) {
+            const Point & point = points[i];
+            CHECK(times[j] == point.time);
+            CHECK(valid.Test(j) == HasData(point));
+            if (HasData(point))
+                CHECK(memcmp(&values[j], &point.value, sizeof(float)) == 0);
+            else
+                CHECK(values[j] == 0.0f);
+        }
+    }
+
+    CHECK(i == points.size());
+    if (!points.empty()) {
+        CHECK(series.GetFirstTime() == points.front().time);
+        CHECK(series.GetLastTime() == points.back().time);
+    }
+
+    return series;
+}
+
+/**
+ * Checks the aggregates of ranges of times against aggregating the points
+ * one by one.
+ *
+ * @param series Series of the points.
+ * @param points Points, sorted by time.
+ * @param bounds Times of the start of the first range and of the end of
+ * every range.
+ */
+void CheckRanges(const CompressedSeries & series,
+        const std::vector<Point> & points,
+        const std::vector<int64_t> & bounds) {
+
+    const auto buckets = series.QueryRanges(bounds);
+    CHECK(buckets.size() + 1 == bounds.size());
+
+    for (size_t x = 0; x < buckets.size(); x++) {
+
+        AggregatePyramid::Bucket expected;
+
+        for (const Point & point : points) {
+            if (point.time < bounds[x] || point.time >= bounds[x + 1]
+                    || !HasData(point))
+                continue;
+            AggregatePyramid::Bucket bucket;
+            bucket.open = bucket.high = bucket.low = bucket.close =
+                point.value;
+            bucket.sum = point.value;
+            bucket.count = 1;
+            AggregatePyramid::Combine(expected, bucket);
+        }
+
+        CHECK(buckets[x].count == expected.count);
+        CHECK(IsClose(buckets[x].sum, expected.sum));
+        CHECK(buckets[x].open == expected.open);
+        CHECK(buckets[x].high == expected.high);
+        CHECK(buckets[x].low == expected.low);
+        CHECK(buckets[x].close == expected.close);
+    }
+}
+
+/**
+ * Checks an empty series.
+ */
+void CheckEmpty() {
+
+    const CompressedSeries series = CheckRoundTrip({});
+
+    CHECK(series.MemoryBytes() == 0);
+    CHECK(series.Query(0, 1000).count == 0);
+    CHECK(series.QueryRanges({}).empty());
+    CheckRanges(series, {}, {-10, 0, 10});
+}
+
+/**
+ * Checks time deltas of delta at the limits of each of their encodings,
+ * and values whose XOR with the previous value has its meaningful bits at
+ * both ends, or takes the whole 32 bits, inside the previous window of
+ * meaningful bits or not.
+ */
+void CheckBitPacking() {
+
+    // deltas of delta just inside and outside the 7, 9 and 12 bit ranges,
+    // then 64 bit ones, both ways
+    const int64_t dods[] = {0, 63, -64, 64, -65, 255, -256, 256, -257, 2047,
+        -2048, 2048, -2049, int64_t(1) << 40, -(int64_t(1) << 40) + 7, 1, 0,
+        0, -1};
+
+    std::vector<Point> points;
+    int64_t time = -(int64_t(1) << 50);
+    int64_t delta = 60;
+
+    for (const int64_t dod : dods) {
+        delta += dod;
+        if (delta <= 0)
+            delta = 1;
+        time += delta;
+        points.push_back({time, 1.0f, true});
+    }
+
+    const uint32_t value_bits[] = {
+        0x3F800000, // 1
+        0x3F800001, // lowest bit flipped
+        0xBF800001, // highest bit flipped
+        0x3F800001,
+        0x40000000, // new window
+        0x40000001, // inside the window
+        0xC07FFFFE, // every bit but the ends flipped
+        0x3F7FFFFF, // whole 32 bits flipped
+        0x00000000, // zero
+        0x80000000, // negative zero
+        0x00000001, // smallest subnormal
+        0x7F800000, // infinity
+        0xFF800000, // negative infinity
+        0x7F7FFFFF, // largest float
+        0x7F7FFFFF, // repeated
+    };
+
+    for (size_t i = 0; i < sizeof(value_bits) / sizeof(uint32_t); i++) {
+        float value;
+        memcpy(&value, &value_bits[i], sizeof(value));
+        time += 1 + int64_t(i % 3);
+        points.push_back({time, value, true});
+    }
+
+    CheckRoundTrip(points);
+
+    // random times and values, so bits cross every word boundary
+    std::mt19937 rng(7);
+    std::vector<Point> random_points;
+    time = 0;
+
+    for (int i = 0; i < 10000; i++) {
+        time += 1 + int64_t(rng() % ((i % 5 == 0) ? 100000 : 3));
+        uint32_t bits = rng();
+        if (i % 4 == 0)
+            bits = 0x42000000 | (bits & 0xFF);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        if (std::isnan(value))
+            value = 1.5f;
+        random_points.push_back({time, value, true});
+    }
+
+    CheckRoundTrip(random_points);
+}
+
+/**
+ * Checks points without data, flagged as such or with NaN values, among
+ * points with data, including negative values such as -1.
+ */
+void CheckGaps() {
+
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    std::vector<Point> points;
+
+    for (int i = 0; i < 300; i++) {
+        const int64_t time = 1000 + i * 60;
+        if (i >= 100 && i < 150)
+            points.push_back({time, (i % 2 == 0) ? nan : 0.0f, i % 2 == 0});
+        else if (i % 5 == 0)
+            points.push_back({time, nan, true});
+        else if (i % 7 == 0)
+            points.push_back({time, -1.0f, false});
+        else if (i % 11 == 0)
+            points.push_back({time, -1.0f, true});
+        else
+            points.push_back({time, float(100 + i % 17), true});
+    }
+
+    const CompressedSeries series = CheckRoundTrip(points);
+
+    CheckRanges(series, points, {1000, 1000 + 100 * 60, 1000 + 150 * 60,
+            1000 + 300 * 60});
+
+    // range of points without data only
+    CHECK(series.Query(1000 + 100 * 60, 1000 + 150 * 60).count == 0);
+}
+
+/**
+ * Checks series of several blocks, with ranges ending at, just before and
+ * just after the bounds of the blocks, and points rejected for not being
+ * after the last point, also at the start of a block.
+ */
+void CheckBlockBounds() {
+
+    const size_t block_size = CompressedSeries::kBlockSize_;
+    std::vector<Point> points;
+
+    for (size_t i = 0; i < 3 * block_size + 5; i++)
+        points.push_back({int64_t(i) * 10, float(i % 1000) * 0.25f,
+                i % 13 != 0});
+
+    CompressedSeries series = CheckRoundTrip(points);
+    CHECK(series.NumBlocks() == 4);
+
+    std::vector<int64_t> bounds = {-5};
+    for (size_t k = 1; k <= 3; k++) {
+        const int64_t time = int64_t(k * block_size) * 10;
+        bounds.push_back(time - 10);
+        bounds.push_back(time);
+        bounds.push_back(time + 10);
+    }
+    bounds.push_back(int64_t(points.size()) * 10);
+
+    CheckRanges(series, points, bounds);
+    CheckRanges(series, points, {0, int64_t(points.size()) * 10});
+    CheckRanges(series, points, {int64_t(block_size) * 10,
+            int64_t(2 * block_size) * 10});
+
+    CHECK(!series.Append(points.back().time, 1.0f, true));
+    CHECK(!series.Append(points.back().time - 1, 1.0f, true));
+    CHECK(series.Size() == points.size());
+
+    // a full last block, so the next point starts a new block
+    CompressedSeries full;
+    for (size_t i = 0; i < block_size; i++)
+        full.Append(int64_t(i), 1.0f, true);
+    CHECK(!full.Append(int64_t(block_size) - 1, 2.0f, true));
+    CHECK(full.NumBlocks() == 1);
+    CHECK(full.Append(int64_t(block_size), 2.0f, true));
+    CHECK(full.NumBlocks() == 2);
+}
+
+}
+
+int main() {
+
+    CheckEmpty();
+    CheckBitPacking();
+    CheckGaps();
+    CheckBlockBounds();
+
+    return check::NumFailures();
+}
@@ -0,0 +1,113 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include "../btc_data.h"
+#include "../dataset.h"
+#include "check.h"
+
+
+namespace {
+
+/**
+ * Writes a file.
+ *
+ * @param path File path.
+ * @param contents File contents.
+ */
+void WriteFile(const std::string & path, const std::string & contents) {
+
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << contents;
+}
+
+}
+
+int main() {
+
+    char dir_template[] = "/tmp/btc_charts_test_XXXXXX";
+    const std::string dir = mkdtemp(dir_template);
+    const std::string prices_path = dir + "/prices.csv";
+    const std::string ohlcv_path = dir + "/ohlcv.csv";
+
+    // prices of several exchanges, from day 600, with empty fields, a day
+    // without prices, a line without time and a repeated day
+    WriteFile(prices_path, "Time,a,b,c\n"
+            "2010-09-01 00:00:00 UTC,10.0,20.0,\n"
+            "2010-09-02 00:00:00 UTC,,,\n"
+            "not a time,1.0,2.0,3.0\n"
+            "2010-09-03 00:00:00 UTC,,4.0,8.0\r\n"
+            "2010-09-03 12:00:00 UTC,5.0,,\n");
+
+    // several columns per row, from day 601, with a missing volume
+    WriteFile(ohlcv_path, "SNo,Name,Symbol,Date,Volume,Open\n"
+            "1,Bitcoin,BTC,2010-09-02 23:59:59,100.5,11.0\n"
+            "2,Bitcoin,BTC,2010-09-03 23:59:59,,12.0\n"
+            "3,Bitcoin,BTC,2010-09-04 23:59:59,300,13.0\n");
+
+    const Dataset dataset({
+            Dataset::BitcoinityPrice(prices_path),
+            {ohlcv_path, 3, {{"volume", 4, 4}, {"open", 5, 5},
+                {"price", 5, 5}}},
+            Dataset::CoinBitcoin(dir + "/missing.csv")});
+
+    // timeline of every day of every source, with columns of readable
+    // sources only, and without repeated columns
+    CHECK(dataset.GetFirstDay() == 600);
+    CHECK(dataset.GetLastDay() == 603);
+    CHECK((dataset.GetColumnNames()
+                == std::vector<std::string>{"open", "price", "volume"}));
+    CHECK(!dataset.HasColumn("high"));
+
+    // prices averaged across exchanges, keeping the last row of each day
+    CHECK(dataset.GetValue("price", 600) == 15.0f);
+    CHECK(dataset.GetValue("price", 601) == -1.0f);
+    CHECK(dataset.GetValue("price", 602) == 5.0f);
+    CHECK(dataset.GetValue("price", 603) == -1.0f);
+
+    // the average of a row matches the price of BtcData
+    const BtcData btc_data(prices_path);
+    CHECK(dataset.GetValue("price", 600) == btc_data.GetPrice(600));
+
+    // single field columns, with missing values and days before the source
+    CHECK(dataset.GetValue("volume", 600) == -1.0f);
+    CHECK(dataset.GetValue("volume", 601) == 100.5f);
+    CHECK(dataset.GetValue("volume", 602) == -1.0f);
+    CHECK(dataset.GetValue("volume", 603) == 300.0f);
+    CHECK(dataset.GetCount("volume", 600, 604) == 2);
+    CHECK(dataset.GetSum("volume", 600, 604) == 400.5);
+    CHECK(dataset.GetMin("open", 600, 604) == 11.0f);
+    CHECK(dataset.GetMax("open", 600, 604) == 13.0f);
+    CHECK(dataset.GetAvg("open", 602, 604) == 12.5f);
+
+    // chart columns of two days each, and of half a day, where only the
+    // columns at the start of a day have data
+    const int64_t time_a = BtcData::TimeOfDay(600);
+    const auto columns = dataset.Resample("open", time_a,
+            BtcData::TimeOfDay(604), 2);
+    CHECK(columns.size() == 2);
+    CHECK(columns[0].avg == -1.0f);
+    CHECK(columns[1].avg == 11.0f && columns[1].last == 11.0f);
+    const auto half_days = dataset.Resample("open", time_a,
+            BtcData::TimeOfDay(604), 8);
+    CHECK(half_days[4].avg == 11.0f && half_days[5].avg == -1.0f);
+    CHECK(half_days[6].first == 12.0f && half_days[7].avg == -1.0f);
+
+    // a single column covers the span before the first time, as in
+    // BtcData::Resample()
+    const auto single = dataset.Resample("open", BtcData::TimeOfDay(604),
+            BtcData::TimeOfDay(608), 1);
+    CHECK(single[0].avg == 12.0f && single[0].min == 11.0f);
+    CHECK(single[0].first == 11.0f && single[0].last == 13.0f);
+    CHECK(dataset.Resample("high", time_a, time_a, 3).size() == 3);
+
+    // unknown columns have no data
+    CHECK(dataset.GetValue("high", 601) == -1.0f);
+    CHECK(dataset.GetCount("high", 600, 604) == 0);
+
+    remove((prices_path + ".cache").c_str());
+    remove(prices_path.c_str());
+    remove(ohlcv_path.c_str());
+    rmdir(dir.c_str());
+
+    return check::NumFailures();
+}
@@ -0,0 +1,51 @@
+#include <cmath>
+#include <limits>
+#include "../img.h"
+#include "check.h"
+
+
+/**
+ * Gets the alpha of a pixel of an image.
+ */
+static int Alpha(const Img & img, const int x, const int y) {
+    return img.Pixels()[(size_t(y) * img.Width() + x) * 4 + 3];
+}
+
+
+int main() {
+
+    // colors with and without alpha
+    CHECK((Img::ParseColor("#12ab3C") == utils::RGBA{0x12, 0xAB, 0x3C, 255}));
+    CHECK((Img::ParseColor("#12ab3C80")
+                == utils::RGBA{0x12, 0xAB, 0x3C, 0x80}));
+
+    // invalid colors are opaque black
+    CHECK((Img::ParseColor("12ab3C") == utils::RGBA{0, 0, 0, 255}));
+    CHECK((Img::ParseColor("#12ab") == utils::RGBA{0, 0, 0, 255}));
+
+    const utils::RGBA red{255, 0, 0, 255};
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float inf = std::numeric_limits<float>::infinity();
+
+    // lines with non-finite ends are not drawn
+    Img empty(8, 8);
+    empty.DrawLine(nan, 0.0f, 4.0f, 4.0f, red);
+    empty.DrawLine(0.0f, 0.0f, 4.0f, inf, red);
+    bool is_empty = true;
+    for (int y = 0; y < 8; y++)
+        for (int x = 0; x < 8; x++)
+            is_empty = is_empty && Alpha(empty, x, y) == 0;
+    CHECK(is_empty);
+
+    // huge steep and shallow lines are clipped to the image
+    Img img(8, 8);
+    img.DrawLine(3.0f, -1e30f, 3.0f, 1e30f, red);
+    img.DrawLine(-1e30f, 5.0f, 1e30f, 5.0f, red);
+    for (int i = 0; i < 8; i++) {
+        CHECK(Alpha(img, 3, i) > 0);
+        CHECK(Alpha(img, i, 5) > 0);
+    }
+    CHECK(Alpha(img, 0, 0) == 0);
+
+    return check::NumFailures();
+}
@@ -0,0 +1,228 @@
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <zlib.h>
+#include "../png_writer.h"
+#include "check.h"
+
+
+namespace {
+
+/// Decoded PNG image data structure.
+struct Png {
+    uint32_t width = 0, height = 0;
+    int bit_depth = 0, color_type = 0;
+    std::vector<uint8_t> rgba; ///< Decoded RGBA pixels.
+};
+
+/**
+ * Reads a big endian 32-bit number.
+ */
+uint32_t ReadU32(const uint8_t * p) {
+
+    return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8
+        | p[3];
+}
+
+/**
+ * Paeth predictor of the PNG filters.
+ */
+int Paeth(const int a, const int b, const int c) {
+
+    const int p = a + b - c;
+    const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+
+    return (pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c;
+}
+
+/**
+ * Decodes the PNG files written by PngWriter, with indexed or RGBA color
+ * types, checking the chunk CRCs and the zlib stream with its Adler-32.
+ *
+ * @param bytes PNG file bytes.
+ * @param png Decoded image.
+ * @return False if the file is not valid.
+ */
+bool Decode(const std::vector<uint8_t> & bytes, Png & png) {
+
+    static const uint8_t signature[] = {137, 80, 78, 71, 13, 10, 26, 10};
+    if (bytes.size() < 8 || !std::equal(signature, signature + 8,
+                bytes.begin()))
+        return false;
+
+    std::vector<uint8_t> palette, alphas, idat;
+    bool has_end = false;
+
+    for (size_t i = 8; i + 12 <= bytes.size() && !has_end; ) {
+
+        const uint32_t size = ReadU32(&bytes[i]);
+        if (i + 12 + size > bytes.size())
+            return false;
+        const std::string type(bytes.begin() + i + 4, bytes.begin() + i + 8);
+        const uint8_t * data = &bytes[i + 8];
+
+        if (crc32(0, &bytes[i + 4], size + 4) != ReadU32(data + size))
+            return false;
+
+        if (type == "IHDR") {
+            if (size != 13 || data[10] || data[11] || data[12])
+                return false;
+            png.width = ReadU32(data);
+            png.height = ReadU32(data + 4);
+            png.bit_depth = data[8];
+            png.color_type = data[9];
+        } else if (type == "PLTE") {
+            palette.assign(data, data + size);
+        } else if (type == "tRNS") {
+            alphas.assign(data, data + size);
+        } else if (type == "IDAT") {
+            idat.insert(idat.end(), data, data + size);
+        } else if (type == "IEND") {
+            has_end = true;
+        }
+
+        i += 12 + size;
+    }
+
+    const bool is_indexed = (png.color_type == 3);
+    if (!has_end || (!is_indexed && (png.color_type != 6
+                    || png.bit_depth != 8)))
+        return false;
+
+    const size_t bpp = is_indexed ? 1 : 4;
+    const size_t row_bytes = is_indexed
+        ? (size_t(png.width) * png.bit_depth + 7) / 8 : png.width * 4;
+
+    // inflates, which checks the Adler-32 of the whole stream
+    std::vector<uint8_t> filtered((row_bytes + 1) * png.height);
+    uLongf filtered_size = filtered.size();
+    if (uncompress(filtered.data(), &filtered_size, idat.data(), idat.size())
+            != Z_OK || filtered_size != filtered.size())
+        return false;
+
+    std::vector<uint8_t> row(row_bytes), prev_row(row_bytes, 0);
+    png.rgba.clear();
+
+    for (uint32_t y = 0; y < png.height; y++) {
+
+        const uint8_t * line = &filtered[(row_bytes + 1) * y];
+        for (size_t x = 0; x < row_bytes; x++) {
+            const int a = (x >= bpp) ? row[x - bpp] : 0;
+            const int b = prev_row[x];
+            const int c = (x >= bpp) ? prev_row[x - bpp] : 0;
+            const int predictors[] = {0, a, b, (a + b) / 2, Paeth(a, b, c)};
+            if (line[0] > 4)
+                return false;
+            row[x] = uint8_t(line[1 + x] + predictors[line[0]]);
+        }
+
+        for (uint32_t x = 0; x < png.width; x++) {
+            if (!is_indexed) {
+                png.rgba.insert(png.rgba.end(), &row[x * 4], &row[x * 4 + 4]);
+                continue;
+            }
+            const size_t bit = size_t(x) * png.bit_depth;
+            const size_t index = (row[bit / 8] >> (8 - png.bit_depth
+                        - bit % 8)) & ((1 << png.bit_depth) - 1);
+            if (3 * index + 3 > palette.size())
+                return false;
+            png.rgba.insert(png.rgba.end(), &palette[3 * index],
+                    &palette[3 * index + 3]);
+            png.rgba.push_back((index < alphas.size()) ? alphas[index] : 255);
+        }
+
+        std::swap(row, prev_row);
+    }
+
+    return true;
+}
+
+/**
+ * Makes an image of a number of colors, with some translucent ones. None
+ * is fully transparent, since those are all written as the same color.
+ *
+ * @param width,height Image width and height sizes.
+ * @param num_colors Number of different colors.
+ * @return RGBA pixels.
+ */
+std::vector<uint8_t> MakeImage(const int width, const int height,
+        const int num_colors) {
+
+    std::vector<uint8_t> rgba;
+
+    for (int i = 0; i < width * height; i++) {
+        const int color = (i * 7 + i / width) % num_colors;
+        rgba.push_back(uint8_t(color));
+        rgba.push_back(uint8_t(color >> 8));
+        rgba.push_back(uint8_t(255 - color));
+        rgba.push_back((color % 3 == 0) ? 255 : uint8_t(1 + color % 250));
+    }
+
+    return rgba;
+}
+
+/**
+ * Checks that an image is decoded back as it was encoded.
+ *
+ * @param width,height Image width and height sizes.
+ * @param num_colors Number of different colors of the image.
+ * @param options Encoding options.
+ * @param color_type Expected PNG color type.
+ * @param bit_depth Expected PNG bit depth.
+ */
+void CheckRoundTrip(const int width, const int height, const int num_colors,
+        const PngWriter::Options & options, const int color_type,
+        const int bit_depth) {
+
+    const auto rgba = MakeImage(width, height, num_colors);
+    std::vector<uint8_t> bytes;
+    PngWriter::Encode(rgba.data(), width, height, options, bytes);
+
+    Png png;
+    CHECK(Decode(bytes, png));
+    CHECK(png.width == uint32_t(width) && png.height == uint32_t(height));
+    CHECK(png.color_type == color_type);
+    CHECK(png.bit_depth == bit_depth);
+    CHECK(png.rgba == rgba);
+}
+
+}
+
+int main() {
+
+    const int num_threads[] = {1, 3, 4, 7};
+
+    for (const int threads : num_threads) {
+
+        PngWriter::Options options;
+        options.num_threads = threads;
+
+        // indexed images of every bit depth, with rows of partial bytes
+        CheckRoundTrip(37, 300, 2, options, 3, 1);
+        CheckRoundTrip(37, 300, 4, options, 3, 2);
+        CheckRoundTrip(37, 300, 16, options, 3, 4);
+        CheckRoundTrip(37, 300, 256, options, 3, 8);
+
+        // more than 256 colors fall back to RGBA
+        CheckRoundTrip(37, 300, 257, options, 6, 8);
+        CheckRoundTrip(64, 500, 5000, options, 6, 8);
+
+        // RGBA with every filter and compression level extremes
+        options.allow_palette = false;
+        for (int filter = PngWriter::kFilterAuto;
+                filter <= PngWriter::kFilterAdaptive; filter++) {
+            options.filter = PngWriter::Filter(filter);
+            CheckRoundTrip(31, 257, 3, options, 6, 8);
+        }
+        options.level = 0;
+        CheckRoundTrip(31, 257, 3, options, 6, 8);
+        options.level = 9;
+        CheckRoundTrip(31, 257, 3, options, 6, 8);
+    }
+
+    // images smaller than a chunk of rows
+    CheckRoundTrip(1, 1, 1, PngWriter::Options(), 3, 1);
+
+    return check::NumFailures();
+}
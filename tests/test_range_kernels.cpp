@@ -0,0 +1,139 @@
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "../range_kernels.h"
+#include "check.h"
+
+
+namespace {
+
+/**
+ * Checks whether two sums are equal up to the rounding of adding values in
+ * another order.
+ */
+bool IsClose(const double x, const double y) {
+
+    return std::fabs(x - y) <= 1e-9 * std::max(std::fabs(x), std::fabs(y));
+}
+
+/**
+ * Checks the selected kernels against the scalar kernels on random ranges
+ * of random columns.
+ *
+ * @param isa Instruction set name of the selected kernels.
+ * @param columns Columns of values.
+ * @param valid Packed validity bitmap words of every column.
+ * @param rng Random number generator of the ranges.
+ */
+void CheckIsa(const std::string & isa,
+        const std::vector<std::vector<float>> & columns,
+        const std::vector<std::vector<uint64_t>> & valid, std::mt19937 & rng) {
+
+    const size_t size = columns[0].size();
+    std::vector<const float *> column_ptrs;
+    std::vector<const uint64_t *> valid_ptrs;
+    for (size_t c = 0; c < columns.size(); c++) {
+        column_ptrs.push_back(columns[c].data());
+        valid_ptrs.push_back(valid[c].data());
+    }
+
+    for (int k = 0; k < 500; k++) {
+
+        // unaligned starts and lengths, down to empty ranges
+        const size_t a = rng() % size;
+        const size_t b = a + rng() % (size - a + 1);
+
+        for (size_t c = 0; c < columns.size(); c++) {
+
+            kernels::SetIsa("scalar");
+            const auto expected = kernels::Reduce(columns[c].data(),
+                    valid[c].data(), a, b);
+            kernels::SetIsa(isa);
+            const auto stats = kernels::Reduce(columns[c].data(),
+                    valid[c].data(), a, b);
+
+            CHECK(stats.count == expected.count);
+            CHECK(IsClose(stats.sum, expected.sum));
+            CHECK(IsClose(stats.sum_sq, expected.sum_sq));
+            CHECK(stats.min == expected.min);
+            CHECK(stats.max == expected.max);
+            CHECK(stats.first == expected.first);
+            CHECK(stats.last == expected.last);
+        }
+
+        std::vector<float> expected[3], rows[3];
+        for (int i = 0; i < 3; i++) {
+            expected[i].resize(b - a);
+            rows[i].resize(b - a);
+        }
+
+        kernels::SetIsa("scalar");
+        kernels::ReduceRows(column_ptrs.data(), valid_ptrs.data(),
+                columns.size(), a, b, expected[0].data(), expected[1].data(),
+                expected[2].data());
+        kernels::SetIsa(isa);
+        kernels::ReduceRows(column_ptrs.data(), valid_ptrs.data(),
+                columns.size(), a, b, rows[0].data(), rows[1].data(),
+                rows[2].data());
+
+        for (int i = 0; i < 3; i++)
+            for (size_t j = 0; j < b - a; j++)
+                CHECK(std::fabs(rows[i][j] - expected[i][j])
+                        <= 1e-6f * std::fabs(expected[i][j]));
+    }
+
+    // logarithms of positive values, leaving the others as they are
+    std::vector<float> values;
+    for (int i = 0; i < 1003; i++)
+        values.push_back((i % 7 == 0) ? -float(i) : 1e-3f * float(i * i));
+    std::vector<float> logs = values;
+    kernels::SetIsa(isa);
+    kernels::LogInPlace(logs.data() + 1, logs.size() - 1);
+
+    CHECK(logs[0] == values[0]);
+    for (size_t i = 1; i < values.size(); i++) {
+        if (values[i] <= 0.0f)
+            CHECK(logs[i] == values[i]);
+        else
+            CHECK(std::fabs(logs[i] - std::log(values[i]))
+                    <= 1e-6f * std::max(1.0f, std::fabs(logs[i])));
+    }
+}
+
+}
+
+int main() {
+
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> price(0.01f, 70000.0f);
+
+    // columns with mostly valid values, few valid values and none
+    const size_t size = 1000;
+    const int valid_percents[] = {90, 10, 0};
+    std::vector<std::vector<float>> columns;
+    std::vector<std::vector<uint64_t>> valid;
+
+    for (const int percent : valid_percents) {
+        columns.emplace_back(size);
+        valid.emplace_back((size + 63) / 64);
+        for (size_t i = 0; i < size; i++) {
+            columns.back()[i] = price(rng);
+            if (int(rng() % 100) < percent)
+                valid.back()[i / 64] |= uint64_t(1) << (i % 64);
+        }
+    }
+
+    const auto isas = kernels::GetIsaNames();
+    CHECK(!isas.empty() && isas.back() == "scalar");
+    CHECK(!kernels::SetIsa("unknown"));
+
+    for (const auto & isa : isas) {
+        CHECK(kernels::SetIsa(isa));
+        CHECK(kernels::GetIsaName() == isa);
+        CheckIsa(isa, columns, valid, rng);
+    }
+
+    return check::NumFailures();
+}
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include "thread_pool.h"
+
+
+/**
+ * Constructor.
+ * Starts the worker threads.
+ *
+ * @param num_threads Number of worker threads, at least 1.
+ */
+ThreadPool::ThreadPool(const int num_threads) {
+
+    for (int i = 0; i < std::max(num_threads, 1); i++)
+        workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+/**
+ * Destructor.
+ * Waits for all queued tasks and stops the worker threads.
+ */
+ThreadPool::~ThreadPool() {
+
+    Wait();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_stopping_ = true;
+    }
+    task_cv_.notify_all();
+
+    for (auto & worker : workers_)
+        worker.join();
+}
+
+/**
+ * Queues a task to be run by a worker thread.
+ *
+ * @param task Task.
+ */
+void ThreadPool::Submit(std::function<void()> task) {
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push(std::move(task));
+        num_pending_++;
+    }
+    task_cv_.notify_one();
+}
+
+/**
+ * Waits until all submitted tasks have finished.
+ */
+void ThreadPool::Wait() {
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return num_pending_ == 0; });
+}
+
+/**
+ * Gets number of worker threads.
+ *
+ * @return Number of worker threads.
+ */
+int ThreadPool::NumThreads() const {
+
+    return int(workers_.size());
+}
+
+/**
+ * Gets default number of worker threads, one per hardware thread.
+ *
+ * @return Number of threads.
+ */
+int ThreadPool::DefaultNumThreads() {
+
+    return std::max(1, int(std::thread::hardware_concurrency()));
+}
+
+/**
+ * Runs queued tasks until the pool is stopped.
+ */
+void ThreadPool::WorkerLoop() {
+
+    while (true) {
+
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            task_cv_.wait(lock, [this] {
+                return is_stopping_ || !tasks_.empty();
+            });
+            if (tasks_.empty())
+                return;
+            task = std::move(tasks_.front());
+            tasks_.pop();
+        }
+
+        task();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            num_pending_--;
+            if (num_pending_ == 0)
+                done_cv_.notify_all();
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+
+/**
+ * Thread pool class, with a fixed number of worker threads running queued
+ * tasks in submission order.
+ */
+class ThreadPool {
+public:
+    // constructor and destructor
+    explicit ThreadPool(const int num_threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool & operator=(const ThreadPool &) = delete;
+
+    // public functions
+    void Submit(std::function<void()> task);
+    void Wait();
+    int NumThreads() const;
+
+    static int DefaultNumThreads();
+
+private:
+    std::vector<std::thread> workers_; ///< Worker threads.
+    std::queue<std::function<void()>> tasks_; ///< Tasks waiting to run.
+
+    std::mutex mutex_; ///< Mutex guarding the queue and counters.
+    std::condition_variable task_cv_; ///< Signals new tasks or stopping.
+    std::condition_variable done_cv_; ///< Signals all tasks finished.
+
+    int num_pending_ = 0; ///< Tasks queued or running.
+    bool is_stopping_ = false; ///< Whether workers have to finish.
+
+    // helper functions
+    void WorkerLoop();
+};
@@ -0,0 +1,196 @@
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+#include "utils.h"
+#include "trade_stream.h"
+
+
+/// Default bytes read from the trades file at once.
+const size_t TradeStream::kDefaultChunkSize_ = 4 * 1024 * 1024;
+
+/**
+ * Constructor.
+ *
+ * @param bucket_size Seconds per bucket, such as 3600 for hourly prices.
+ * @param chunk_size Bytes read from the file at once, which is also the
+ * maximum length of a line.
+ */
+TradeStream::TradeStream(const int64_t bucket_size, const size_t chunk_size)
+    : bucket_size_(bucket_size), chunk_size_(chunk_size) {}
+
+/**
+ * Reads a trades file chunk by chunk and appends its buckets to Bitcoin
+ * data. The price of each bucket is the average price of its trades,
+ * weighted by their amounts when the file has them.
+ *
+ * Trades have to be sorted by bucket, although trades in the same bucket
+ * can be in any order. Trades of a bucket already appended, as well as
+ * lines that are not valid trades, such as a titles line, are skipped.
+ *
+ * @param path Trades file path.
+ * @param btc_data Bitcoin data to append the buckets to.
+ * @return True if the file could be read.
+ */
+bool TradeStream::Ingest(const std::string & path, BtcData & btc_data) {
+
+    if (bucket_size_ <= 0 || chunk_size_ == 0)
+        return false;
+
+    const int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        std::cerr << "Error: could not open " << path << '\n';
+        return false;
+    }
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    std::vector<char> buffer(chunk_size_);
+    size_t size = 0; // bytes in the buffer
+    bool is_skipping_line = false; // whether a too long line is discarded
+    bool ok = true;
+
+    while (true) {
+
+        const ssize_t n = read(fd, buffer.data() + size, buffer.size() - size);
+        if (n < 0) {
+            ok = false;
+            break;
+        }
+        size += size_t(n);
+
+        const std::string_view chunk(buffer.data(), size);
+        size_t pos = 0;
+
+        for (size_t eol; (eol = chunk.find('\n', pos))
+                != std::string_view::npos; pos = eol + 1) {
+            if (is_skipping_line)
+                is_skipping_line = false;
+            else
+                IngestLine(chunk.substr(pos, eol - pos), btc_data);
+        }
+
+        if (n == 0) {
+            if (pos < size && !is_skipping_line)
+                IngestLine(chunk.substr(pos), btc_data);
+            break;
+        }
+
+        // a line filling the whole buffer is skipped up to its line break
+        if (pos == 0 && size == buffer.size()) {
+            if (!is_skipping_line)
+                num_skipped_++;
+            is_skipping_line = true;
+            size = 0;
+            continue;
+        }
+
+        memmove(buffer.data(), buffer.data() + pos, size - pos);
+        size -= pos;
+    }
+
+    close(fd);
+
+    FlushBucket(btc_data);
+
+    return ok;
+}
+
+/**
+ * Gets number of trades aggregated into appended buckets.
+ *
+ * @return Number of trades.
+ */
+size_t TradeStream::GetNumTrades() const {
+
+    return num_trades_;
+}
+
+/**
+ * Gets number of lines skipped.
+ *
+ * @return Number of lines.
+ */
+size_t TradeStream::GetNumSkipped() const {
+
+    return num_skipped_;
+}
+
+/**
+ * Aggregates one trade line into the current bucket, appending the
+ * current bucket first if the trade is in a later one.
+ *
+ * @param line View of a 'time,price[,amount]' line, where time is in
+ * epoch seconds or 'YYYY-MM-DD HH:MM:SS'.
+ * @param btc_data Bitcoin data to append buckets to.
+ */
+void TradeStream::IngestLine(std::string_view line, BtcData & btc_data) {
+
+    if (!line.empty() && line.back() == '\r')
+        line.remove_suffix(1);
+
+    const size_t comma = line.find(',');
+    if (comma == std::string_view::npos) {
+        num_skipped_++;
+        return;
+    }
+
+    int64_t time;
+    float price;
+    double amount = 1.0;
+
+    const char * const end = line.data() + line.size();
+    const auto res = std::from_chars(line.data() + comma + 1, end, price);
+
+    bool is_valid = utils::ParseTime(line.substr(0, comma), time)
+        && res.ec == std::errc() && price >= 0;
+
+    if (is_valid && res.ptr < end && *res.ptr == ',')
+        is_valid = std::from_chars(res.ptr + 1, end, amount).ec
+            == std::errc() && amount > 0;
+
+    // floors time to the start of its bucket, also for negative times
+    const int64_t bucket_time = is_valid ? (time - ((time % bucket_size_
+                    + bucket_size_) % bucket_size_)) : 0;
+
+    if (!is_valid || (has_bucket_ && bucket_time < bucket_time_)) {
+        num_skipped_++;
+        return;
+    }
+
+    if (has_bucket_ && bucket_time > bucket_time_)
+        FlushBucket(btc_data);
+
+    has_bucket_ = true;
+    bucket_time_ = bucket_time;
+    bucket_trades_++;
+    amount_sum_ += amount;
+    value_sum_ += double(price) * amount;
+}
+
+/**
+ * Appends the current bucket, if it has trades, and empties it.
+ *
+ * @param btc_data Bitcoin data to append the bucket to.
+ */
+void TradeStream::FlushBucket(BtcData & btc_data) {
+
+    if (!has_bucket_)
+        return;
+
+    BtcData::TimeBtcData time_btc_data;
+    time_btc_data.time = bucket_time_;
+    time_btc_data.price = float(value_sum_ / amount_sum_);
+
+    if (btc_data.Append(time_btc_data))
+        num_trades_ += bucket_trades_;
+    else
+        num_skipped_ += bucket_trades_;
+
+    has_bucket_ = false;
+    bucket_trades_ = 0;
+    amount_sum_ = value_sum_ = 0.0;
+}
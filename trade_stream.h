@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "btc_data.h"
+
+
+/**
+ * Trade stream class.
+ *
+ * Streams a trades file, with one 'time,price[,amount]' line per trade,
+ * through a fixed-size buffer and aggregates its trades on the fly into
+ * buckets of a fixed number of seconds, which are appended to a BtcData
+ * object. Memory use does not depend on the size of the file, only on the
+ * number of buckets.
+ */
+class TradeStream {
+public:
+    static const size_t kDefaultChunkSize_;
+
+    // constructor
+    explicit TradeStream(const int64_t bucket_size,
+            const size_t chunk_size = kDefaultChunkSize_);
+
+    // public functions
+    bool Ingest(const std::string & path, BtcData & btc_data);
+    size_t GetNumTrades() const;
+    size_t GetNumSkipped() const;
+
+private:
+    int64_t bucket_size_; ///< Seconds per bucket.
+    size_t chunk_size_; ///< Bytes read from the file at once.
+
+    size_t num_trades_ = 0; ///< Trades aggregated into buckets.
+    /// Lines skipped, because they were not valid trades or their bucket
+    /// had already been appended.
+    size_t num_skipped_ = 0;
+
+    // aggregates of the current bucket
+    bool has_bucket_ = false; ///< Whether a bucket has trades.
+    int64_t bucket_time_ = 0; ///< Start time of the bucket.
+    size_t bucket_trades_ = 0; ///< Number of trades.
+    double amount_sum_ = 0.0; ///< Sum of amounts.
+    double value_sum_ = 0.0; ///< Sum of prices times amounts.
+
+    // helper functions
+    void IngestLine(std::string_view line, BtcData & btc_data);
+    void FlushBucket(BtcData & btc_data);
+};
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
 #include <vector>
 #include <math.h>
 #include <numeric>
@@ -17,6 +22,152 @@ struct Date {
     int y = 0, m = 0, d = 0;
 };
 
+/**
+ * Gets number of days from 1970-01-01 to a date of the proleptic Gregorian
+ * calendar.
+ *
+ * @param date Date.
+ * @return Days since 1970-01-01, negative for earlier dates.
+ */
+constexpr int DaysFromCivil(const Date & date) {
+
+    const int y = date.y - (date.m <= 2);
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const int yoe = y - era * 400;
+    const int doy = (153 * (date.m + (date.m > 2 ? -3 : 9)) + 2) / 5
+        + date.d - 1;
+    const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    return era * 146097 + doe - 719468;
+}
+
+/**
+ * Checks whether a date has a valid month and day of month.
+ *
+ * @param date Date.
+ * @return True if the date is valid.
+ */
+constexpr bool IsValidDate(const Date & date) {
+
+    constexpr int month_days[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31,
+        30, 31};
+
+    if (date.m < 1 || date.m > 12 || date.d < 1
+            || date.d > month_days[date.m - 1])
+        return false;
+
+    // February 29th only on leap years
+    return date.m != 2 || date.d != 29 || (date.y % 4 == 0
+            && (date.y % 100 != 0 || date.y % 400 == 0));
+}
+
+/**
+ * Parses a time, either as 'YYYY-MM-DD', optionally followed by ' HH:MM'
+ * or 'THH:MM' and ':SS' (in UTC, anything after it is ignored), or as a
+ * number of epoch seconds.
+ *
+ * @param str View of a string containing the time.
+ * @param time Parsed time, in seconds since 1970-01-01 00:00:00 UTC.
+ * @return True if the string contained a valid time.
+ */
+inline bool ParseTime(std::string_view str, int64_t & time) {
+
+    Date date;
+    int hms[3] = {0, 0, 0};
+
+    const char * p = str.data();
+    const char * const end = p + str.size();
+
+    int64_t number;
+    const auto res = std::from_chars(p, end, number);
+    if (res.ec != std::errc())
+        return false;
+    if (res.ptr == end || *res.ptr != '-') {
+        time = number;
+        return res.ptr == end;
+    }
+
+    int * const date_fields[] = {&date.y, &date.m, &date.d};
+
+    for (int i = 0; i < 3; i++) {
+        const auto field = std::from_chars(p, end, *date_fields[i]);
+        if (field.ec != std::errc())
+            return false;
+        p = field.ptr;
+        if (i < 2 && (p == end || *p++ != '-'))
+            return false;
+    }
+
+    if (!IsValidDate(date))
+        return false;
+
+    if (p + 1 < end && (*p == ' ' || *p == 'T')
+            && p[1] >= '0' && p[1] <= '9') {
+        p++;
+        for (int i = 0; i < 3 && p < end; i++) {
+            const auto field = std::from_chars(p, end, hms[i]);
+            if (field.ec != std::errc())
+                return false;
+            p = field.ptr;
+            if (p == end || *p != ':')
+                break;
+            p++;
+        }
+    }
+
+    time = int64_t(DaysFromCivil(date)) * 86400 + hms[0] * 3600
+        + hms[1] * 60 + hms[2];
+
+    return true;
+}
+
+/**
+ * Parses the numbers of a string of fields separated by commas, in a
+ * single pass, into one number per field and their average. Empty and
+ * non-numeric fields are skipped.
+ *
+ * @param str View of a string containing fields separated by commas.
+ * @param numbers Parsed number of each field, or -1 for skipped fields.
+ * @param num_numbers Number of fields parsed into numbers, which are all
+ * averaged anyway.
+ * @param average Average of the parsed numbers, only set if there is any.
+ * @return Number of parsed numbers.
+ */
+inline int ParseAverage(std::string_view str, float * numbers,
+        const size_t num_numbers, float & average) {
+
+    std::fill(numbers, numbers + num_numbers, -1.0f);
+
+    int num_values = 0;
+    float sum = 0.0f;
+
+    const char * p = str.data();
+    const char * const end = p + str.size();
+
+    for (size_t k = 0; p < end; k++) {
+
+        const char * comma = static_cast<const char *>(
+                memchr(p, ',', end - p));
+        if (!comma)
+            comma = end;
+
+        float number;
+        if (std::from_chars(p, comma, number).ec == std::errc()) {
+            sum += number;
+            num_values++;
+            if (k < num_numbers)
+                numbers[k] = number;
+        }
+
+        p = comma + 1;
+    }
+
+    if (num_values > 0)
+        average = sum / num_values;
+
+    return num_values;
+}
+
 /// Numeric scales enumeration.
 enum Scale {kLinear, kLogarithmic};
 